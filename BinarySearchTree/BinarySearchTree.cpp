@@ -6,10 +6,12 @@
 // Description : Hello World in C++, Ansi-style
 //============================================================================
 
+#include <filesystem>
 #include <iostream>
+#include <string_view>
 #include <time.h>
 
-#include "CSVparser.hpp"
+#include "Bid.hpp"
 
 using namespace std;
 
@@ -17,23 +19,11 @@ using namespace std;
 // Global definitions visible to all methods and classes
 //============================================================================
 
-// forward declarations
-double strToDouble(string str, char ch);
-
-// define a structure to hold bid information
-struct Bid {
-    string bidId; // unique identifier
-    string title;
-    string fund;
-    double amount;
-    Bid() {
-        amount = 0.0;
-    }
-};
-
 // Internal structure for tree node
 struct Node {
     Bid bid;
+    // the key of the bid, which orders the tree
+    BidKey::Type key;
     Node *left;
     Node *right;
 
@@ -43,10 +33,11 @@ struct Node {
         right = nullptr;
     }
 
-    // initialize with a bid
-    Node(Bid aBid) :
+    // initialize with a bid and its key, taking over its strings
+    Node(Bid&& aBid, BidKey::Type aKey) :
             Node() {
-        bid = aBid;
+        bid = move(aBid);
+        key = aKey;
     }
 };
 
@@ -63,11 +54,11 @@ class BinarySearchTree {
 private:
     Node* root;
 
-    void addNode(Node* node, Bid bid);
+    void addNode(Node* node, Bid&& bid, BidKey::Type key);
     void inOrder(Node* node);
 	void preOrder(Node* node);
     void postOrder(Node* node);
-    Node* removeNode(Node* node, string bidId);
+    Node* removeNode(Node* node, string_view bidId);
 
 public:
     BinarySearchTree();
@@ -75,9 +66,10 @@ public:
     void InOrder();
 	void PreOrder();
     void PostOrder();
-    void Insert(Bid bid);
-    void Remove(string bidId);
-    Bid Search(string bidId);
+    void Insert(Bid&& bid);
+    void Insert(const Bid& bid);
+    void Remove(string_view bidId);
+    const Bid* Search(string_view bidId) const;
 };
 
 /**
@@ -130,15 +122,21 @@ void BinarySearchTree::PreOrder() {
 }
 
 /**
- * Insert a bid
+ * Insert a bid, moving it into the tree
  */
-void BinarySearchTree::Insert(Bid bid) {
+void BinarySearchTree::Insert(Bid&& bid) {
 	// FIXME (5) Implement inserting a bid into the tree
+	// the key the tree is ordered by
+	BidKey::Type key;
+	if (!BidKey::parse(bid.bidId, key)) {
+		cerr << "Bid id " << bid.bidId << " is not a valid key, skipped" << endl;
+		return;
+	}
 	// root is equal to new node bid
-	Node* node = new Node(bid);
+	Node* node = new Node(move(bid), key);
 	// if root equarl to null ptr
-	if (root == nullptr) {
-		root = new Node(bid);
+	if (root == nullptr) {
+		root = node;
 		node->left = nullptr;
 		node->right = nullptr;
 	}
@@ -148,7 +146,7 @@ void BinarySearchTree::Insert(Bid bid) {
 
 		while (cur != nullptr) {
 			//if node is less than current node, insert bid
-			if (node->bid.bidId < cur->bid.bidId) {
+			if (node->key < cur->key) {
 				// if left child of current node is empty, insert bid to left child
 				if (cur->left == nullptr) {
 					cur->left = node;
@@ -176,20 +174,33 @@ void BinarySearchTree::Insert(Bid bid) {
 
 }
 
+/**
+ * Insert a copy of a bid
+ */
+void BinarySearchTree::Insert(const Bid& bid) {
+    Insert(Bid(bid));
+}
+
 /**
  * Remove a bid
  */
-void BinarySearchTree::Remove(string bidId) {
+void BinarySearchTree::Remove(string_view bidId) {
     // FIXME (6) Implement removing a bid from the tree
     // remove node root bidID
-	cout << "Enter bid ID: ";
-	cin >> bidId;
-	Node* cur = root;
+	cout << "Enter bid ID: ";
+	string entered;
+	cin >> entered;
+	bidId = entered;
+	BidKey::Type key;
+	if (!BidKey::parse(bidId, key)) {
+		return;
+	}
+	Node* cur = root;
 	Node* par = nullptr;
 	//search for node
 	while (cur != nullptr) {
 		// node found
-		if (cur->bid.bidId == bidId) { 
+		if (cur->key == key) { 
 			if (cur->left == nullptr && cur->right == nullptr) {
 				if (par == nullptr) {
 					root = nullptr;
@@ -236,7 +247,7 @@ void BinarySearchTree::Remove(string bidId) {
 			return; 
 		}
 		// search right
-		else if (cur->bid.bidId < bidId) { 
+		else if (cur->key < key) { 
 			par = cur;
 			cur = cur->right;
 		}
@@ -252,21 +263,29 @@ void BinarySearchTree::Remove(string bidId) {
 
 /**
  * Search for a bid
+ *
+ * @return the bid found, held by the tree, or nullptr
  */
-Bid BinarySearchTree::Search(string bidId) {
+const Bid* BinarySearchTree::Search(string_view bidId) const {
     // FIXME (7) Implement searching the tree for a bid
-	cout << "Enter bid ID: ";
-	cin >> bidId;
-	// set current node equal to root
+	cout << "Enter bid ID: ";
+	string entered;
+	cin >> entered;
+	bidId = entered;
+	BidKey::Type key;
+	if (!BidKey::parse(bidId, key)) {
+		return nullptr;
+	}
+	// set current node equal to root
 	Node* current = root;
 	// keep looping downwards until bottom reached or matching bidId found
 	while (current != nullptr) {
 		// if match found, return current bid
-		if (current->bid.bidId.compare(bidId) == 0) {
-			return current->bid;
+		if (current->key == key) {
+			return &current->bid;
 		}
 		// if bid is smaller than current node then traverse left
-		if (bidId.compare(current->bid.bidId) < 0) {
+		if (key < current->key) {
 			current = current->left;
 		}
 		// else larger so traverse right
@@ -274,28 +293,28 @@ Bid BinarySearchTree::Search(string bidId) {
 			current = current->right;
 		}
 	}
-	Bid bid;
-	return bid;
-}
+	return nullptr;
+}
 
 /**
  * Add a bid to some node (recursive)
  *
  * @param node Current node in tree
  * @param bid Bid to be added
+ * @param key The key of the bid
  */
-void BinarySearchTree::addNode(Node* node, Bid bid) {
+void BinarySearchTree::addNode(Node* node, Bid&& bid, BidKey::Type key) {
     // FIXME (8) Implement inserting a bid into the tree
 	// if node is larger then add to left
-	if(node->bid.bidId.compare(bid.bidId) > 0){
+	if(node->key > key){
 		// if no left node
 		if(node->left == nullptr){
 			// this node becomes left
-			node->left = new Node(bid);
+			node->left = new Node(move(bid), key);
 		}
 		// else recurse down the left node
 		else{
-			this->addNode(node->left, bid);
+			this->addNode(node->left, move(bid), key);
 		}
 	}
 	// else
@@ -303,12 +322,12 @@ void BinarySearchTree::addNode(Node* node, Bid bid) {
 		// if no right node
 		if(node->right == nullptr){
 			 // this node becomes right
-			node->right = new Node(bid);
+			node->right = new Node(move(bid), key);
 		}
 		//else
 		else{
 			// recurse down the left node
-			this->addNode(node->right, bid);
+			this->addNode(node->right, move(bid), key);
 		}
 	}
 }
@@ -355,90 +374,26 @@ void BinarySearchTree::preOrder(Node* node) {
 // Static methods used for testing
 //============================================================================
 
-/**
- * Display the bid information to the console (std::out)
- *
- * @param bid struct containing the bid info
- */
-void displayBid(Bid bid) {
-    cout << bid.bidId << ": " << bid.title << " | " << bid.amount << " | "
-            << bid.fund << endl;
-    return;
-}
-
-/**
- * Load a CSV file containing bids into a container
- *
- * @param csvPath the path to the CSV file to load
- * @return a container holding all the bids read
- */
-void loadBids(string csvPath, BinarySearchTree* bst) {
-    cout << "Loading CSV file " << csvPath << endl;
-
-    // initialize the CSV Parser using the given path
-    csv::Parser file = csv::Parser(csvPath);
-
-    // read and display header row - optional
-    vector<string> header = file.getHeader();
-    for (auto const& c : header) {
-        cout << c << " | ";
-    }
-    cout << "" << endl;
-
-    try {
-        // loop to read rows of a CSV file
-        for (unsigned int i = 0; i < file.rowCount(); i++) {
-
-            // Create a data structure and add to the collection of bids
-            Bid bid;
-            bid.bidId = file[i][1];
-            bid.title = file[i][0];
-            bid.fund = file[i][8];
-            bid.amount = strToDouble(file[i][4], '$');
-
-            //cout << "Item: " << bid.title << ", Fund: " << bid.fund << ", Amount: " << bid.amount << endl;
-
-            // push this bid to the end
-            bst->Insert(bid);
-        }
-    } catch (csv::Error &e) {
-        std::cerr << e.what() << std::endl;
-    }
-}
-
-/**
- * Simple C function to convert a string to a double
- * after stripping out unwanted char
- *
- * credit: http://stackoverflow.com/a/24875936
- *
- * @param ch The character to strip out
- */
-double strToDouble(string str, char ch) {
-    str.erase(remove(str.begin(), str.end(), ch), str.end());
-    return atof(str.c_str());
-}
-
 /**
  * The one and only main() method
  */
 int main(int argc, char* argv[]) {
 
-    // process command line arguments
-    string csvPath, bidKey;
-    switch (argc) {
-    case 2:
-        csvPath = argv[1];
-        bidKey = "98109";
-        break;
-    case 3:
-        csvPath = argv[1];
-        bidKey = argv[2];
-        break;
-    default:
-        csvPath = "eBid_Monthly_Sales_Dec_2016.csv";
-        bidKey = "98109";
+    // process command line arguments: CSV files (or directories of them),
+    // then the bid key unless the last one is a file too
+    vector<string> csvPaths;
+    string bidKey = "98109";
+    for (int i = 1; i < argc; i++) {
+        if (i > 1 && i == argc - 1 && !filesystem::exists(argv[i])) {
+            bidKey = argv[i];
+        } else {
+            csvPaths.push_back(argv[i]);
+        }
+    }
+    if (csvPaths.empty()) {
+        csvPaths.push_back("eBid_Monthly_Sales_Dec_2016.csv");
     }
+    csvPaths = csv::listFiles(csvPaths);
 
     // Define a timer variable
     clock_t ticks;
@@ -446,15 +401,33 @@ int main(int argc, char* argv[]) {
     // Define a binary search tree to hold all bids
     BinarySearchTree* bst;
     bst = new BinarySearchTree();
-    Bid bid;
+    const Bid* found = nullptr;
+
+    // the loaders move every bid they read into the tree
+    BidSink addBid = [bst](Bid&& bid) {
+        bst->Insert(move(bid));
+    };
+
+    // the newest CSV file, followed from choice 5 on: it is polled for
+    // new bids before every prompt
+    csv::Follower* follower = nullptr;
+    // where the last load stopped in that file
+    csv::Position loaded;
 
     int choice = 0;
     while (choice != 9) {
+        if (follower != nullptr) {
+            unsigned long added = followBids(follower, addBid);
+            if (added > 0) {
+                cout << added << " new bids in " << csvPaths.back() << endl;
+            }
+        }
         cout << "Menu:" << endl;
         cout << "  1. Load Bids" << endl;
         cout << "  2. Display All Bids" << endl;
         cout << "  3. Find Bid" << endl;
         cout << "  4. Remove Bid" << endl;
+        cout << "  5. Follow Bids" << endl;
         cout << "  9. Exit" << endl;
         cout << "Enter choice: ";
         cin >> choice;
@@ -467,7 +440,11 @@ int main(int argc, char* argv[]) {
             ticks = clock();
 
             // Complete the method call to load the bids
-            loadBids(csvPath, bst);
+            if (csvPaths.size() == 1) {
+                loaded = loadBids(csvPaths[0], addBid);
+            } else {
+                loaded = loadAllBids(csvPaths, addBid);
+            }
 
             //cout << bst->Size() << " bids read" << endl;
 
@@ -484,12 +461,12 @@ int main(int argc, char* argv[]) {
         case 3:
             ticks = clock();
 
-            bid = bst->Search(bidKey);
+            found = bst->Search(bidKey);
 
             ticks = clock() - ticks; // current clock ticks minus starting clock ticks
 
-            if (!bid.bidId.empty()) {
-                displayBid(bid);
+            if (found != nullptr) {
+                displayBid(*found);
             } else {
             	cout << "Bid Id " << bidKey << " not found." << endl;
             }
@@ -502,9 +479,29 @@ int main(int argc, char* argv[]) {
         case 4:
             bst->Remove(bidKey);
             break;
+
+        case 5:
+            // load the bids of the newest file not loaded yet, then keep
+            // adding the ones appended to it
+            if (follower == nullptr) {
+                csv::Options options;
+                options.lenient = true;
+                follower = new csv::Follower(csvPaths.back(), ',', options);
+                follower->resume(loaded);
+            }
+            ticks = clock();
+
+            cout << followBids(follower, addBid) << " bids read from " << csvPaths.back() << endl;
+
+            ticks = clock() - ticks; // current clock ticks minus starting clock ticks
+            cout << "time: " << ticks << " clock ticks" << endl;
+            cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
+            break;
         }
     }
 
+    delete follower;
+
     cout << "Good bye." << endl;
 
 	return 0;
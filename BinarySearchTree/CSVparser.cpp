@@ -1,268 +1,2936 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
 #include <fstream>
+#include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <thread>
 #include "CSVparser.hpp"
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define CSV_X86 1
+# include <immintrin.h>
+# ifdef _MSC_VER
+#  include <intrin.h>
+#  define CSV_TARGET_AVX2
+# else
+#  define CSV_TARGET_AVX2 __attribute__((target("avx2")))
+# endif
+#else
+# define CSV_X86 0
+#endif
+
+#ifdef _WIN32
+# define WIN32_LEAN_AND_MEAN
+# define NOMINMAX
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
 namespace csv {
 
-  Parser::Parser(const std::string &data, const DataType &type, char sep)
-    : _type(type), _sep(sep)
+  Parser::Parser(const std::string &data, const DataType &type, char sep,
+                 const Options &options)
+    : _type(type), _sep(sep), _options(options), _journalSize(0)
   {
-      std::string line;
-      if (type == eFILE)
+      if (type == eFILE && !_options.lazy)
       {
         _file = data;
         std::ifstream ifile(_file.c_str());
-        if (ifile.is_open())
-        {
-            while (ifile.good())
-            {
-                getline(ifile, line);
-                if (line != "")
-                    _originalFile.push_back(line);
-            }
-            ifile.close();
-
-            if (_originalFile.size() == 0)
-              throw Error(std::string("No Data in ").append(_file));
-            
-            parseHeader();
-            parseContent();
-        }
-        else
+        if (!ifile.is_open())
             throw Error(std::string("Failed to open ").append(_file));
+
+        char chunk[65536];
+        while (ifile.read(chunk, sizeof(chunk)) || ifile.gcount() > 0)
+            _buffer.append(chunk, ifile.gcount());
+        ifile.close();
+        _data = _buffer;
       }
-      else
+      else if (type == eMMAP || type == eFILE)
       {
-        std::istringstream stream(data);
-        while (std::getline(stream, line))
-          if (line != "")
-            _originalFile.push_back(line);
-        if (_originalFile.size() == 0)
-          throw Error(std::string("No Data in pure content"));
+        // a lazy eFILE parser maps its file too: it must not hold a copy
+        _file = data;
+        if (!_map.open(_file))
+            throw Error(std::string("Failed to open ").append(_file));
+        _data = std::string_view(_map.data(), _map.size());
+      }
+      else if (_options.lazy)
+      {
+        // rows are split later on: keep a copy of the content
+        _buffer = data;
+        _data = _buffer;
+      }
+      else
+        _data = data;
 
-        parseHeader();
-        parseContent();
+      parseHeader();
+      if (_options.lazy)
+      {
+        if (_options.journal)
+          throw Error("can't replay a journal on a lazily loaded file");
+        // rows are split from _data on demand
+        indexLines();
+        return;
       }
+      parseContent();
+      if (_options.journal && type != ePURE)
+        replayJournal();
+
+      // rows own their values unless they point into the mapping
+      _data = std::string_view();
+      std::string().swap(_buffer);
   }
 
   Parser::~Parser(void)
   {
-     std::vector<Row *>::iterator it;
+     // the rows live in _arenas, which free them all at once
+  }
 
-     for (it = _content.begin(); it != _content.end(); it++)
-          delete *it;
+  /*
+  ** Size and modification time of `path`, which tell whether a snapshot
+  ** or a journal still belongs to it.
+  */
+  static bool fileStamp(const std::string &path, std::uint64_t &size, std::int64_t &time)
+  {
+      std::error_code ec;
+      std::uintmax_t bytes = std::filesystem::file_size(path, ec);
+      if (ec)
+        return false;
+      std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, ec);
+      if (ec)
+        return false;
+      size = bytes;
+      time = static_cast<std::int64_t>(modified.time_since_epoch().count());
+      return true;
   }
 
-  void Parser::parseHeader(void)
+  // first line of a journal (see Parser::replayJournal)
+  static std::string journalHeader(std::uint64_t size, std::int64_t time)
   {
-      std::stringstream ss(_originalFile[0]);
-      std::string item;
+      return std::string("CSVJOURNAL 1 ").append(std::to_string(size))
+        .append(" ").append(std::to_string(time)).append("\n");
+  }
 
-      while (std::getline(ss, item, _sep))
-          _header.push_back(item);
+  // read "<number><end>" off the front of `rest`
+  static bool readCount(std::string_view &rest, std::size_t &out, char end)
+  {
+      const char *last = rest.data() + rest.size();
+      std::from_chars_result res = std::from_chars(rest.data(), last, out);
+
+      if (res.ec != std::errc() || res.ptr == last || *res.ptr != end)
+        return false;
+      rest.remove_prefix(res.ptr + 1 - rest.data());
+      return true;
   }
 
-  void Parser::parseContent(void)
+  /*
+  ** Cut the next line (without its '\n') off the front of `rest`.
+  */
+  static std::string_view nextLine(std::string_view &rest)
   {
-     std::vector<std::string>::iterator it;
-     
-     it = _originalFile.begin();
-     it++; // skip header
+      std::size_t end = rest.find('\n');
+      std::string_view line = rest.substr(0, end);
 
-     for (; it != _originalFile.end(); it++)
-     {
-         bool quoted = false;
-         int tokenStart = 0;
-         unsigned int i = 0;
+      rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+      return line;
+  }
 
-         Row *row = new Row(_header);
+  static std::shared_ptr<const Schema> splitHeader(std::string_view line, char sep,
+                                                   const Options &options)
+  {
+      std::stringstream ss{std::string(line)};
+      std::vector<std::string> header;
+      std::string item;
 
-         for (; i != it->length(); i++)
-         {
-              if (it->at(i) == '"')
-                  quoted = ((quoted) ? (false) : (true));
-              else if (it->at(i) == ',' && !quoted)
-              {
-                  row->push(it->substr(tokenStart, i - tokenStart));
-                  tokenStart = i + 1;
-              }
-         }
+      while (std::getline(ss, item, sep))
+          header.push_back(item);
+      if (options.columns.empty() && options.columnNames.empty())
+          return std::make_shared<const Schema>(header);
 
-         //end
-         row->push(it->substr(tokenStart, it->length() - tokenStart));
+      std::vector<unsigned int> columns = options.columns;
+      for (auto it = options.columnNames.begin(); it != options.columnNames.end(); it++)
+      {
+          auto pos = std::find(header.begin(), header.end(), *it);
 
-         // if value(s) missing
-         if (row->size() != _header.size())
-          throw Error("corrupted data !");
-         _content.push_back(row);
-     }
+          if (pos == header.end())
+              throw Error(std::string("no column named ").append(*it));
+          columns.push_back(pos - header.begin());
+      }
+      return std::make_shared<const Schema>(header, columns);
   }
 
-  Row &Parser::getRow(unsigned int rowPosition) const
+  /*
+  ** FIELD SCANNER
+  **
+  ** The input is classified 64 bytes at a time into separator, quote and
+  ** newline bitmaps, with SSE2 or AVX2 when the CPU has them (picked at
+  ** run time) and a scalar loop otherwise. The quoted regions are then the
+  ** prefix xor of the quote bitmap, so finding the separators that end a
+  ** field needs no per-byte branching at all. Each record comes out as the
+  ** offsets of its field ends.
+  */
+
+  typedef void (*ClassifyFn)(const char *, char, std::uint64_t *);
+
+#if !CSV_X86
+  static void classifyScalar(const char *p, char sep, std::uint64_t *masks)
   {
-      if (rowPosition < _content.size())
-          return *(_content[rowPosition]);
-      throw Error("can't return this row (doesn't exist)");
+      std::uint64_t seps = 0;
+      std::uint64_t quotes = 0;
+      std::uint64_t newlines = 0;
+
+      for (unsigned int i = 0; i != 64; i++)
+      {
+        std::uint64_t bit = std::uint64_t(1) << i;
+
+        if (p[i] == sep)
+          seps |= bit;
+        if (p[i] == '"')
+          quotes |= bit;
+        if (p[i] == '\n')
+          newlines |= bit;
+      }
+      masks[0] = seps;
+      masks[1] = quotes;
+      masks[2] = newlines;
   }
+#endif
 
-  Row &Parser::operator[](unsigned int rowPosition) const
+#if CSV_X86
+  static std::uint64_t movemask16(__m128i block, __m128i c)
   {
-      return Parser::getRow(rowPosition);
+      return static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, c)));
   }
 
-  unsigned int Parser::rowCount(void) const
+  static void classifySse2(const char *p, char sep, std::uint64_t *masks)
   {
-      return _content.size();
+      const __m128i seps = _mm_set1_epi8(sep);
+      const __m128i quotes = _mm_set1_epi8('"');
+      const __m128i newlines = _mm_set1_epi8('\n');
+
+      masks[0] = masks[1] = masks[2] = 0;
+      for (unsigned int i = 0; i != 4; i++)
+      {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i));
+
+        masks[0] |= movemask16(block, seps) << (16 * i);
+        masks[1] |= movemask16(block, quotes) << (16 * i);
+        masks[2] |= movemask16(block, newlines) << (16 * i);
+      }
   }
 
-  unsigned int Parser::columnCount(void) const
+  CSV_TARGET_AVX2 static std::uint64_t movemask32(__m256i block, __m256i c)
   {
-      return _header.size();
+      return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, c)));
   }
 
-  std::vector<std::string> Parser::getHeader(void) const
+  CSV_TARGET_AVX2 static void classifyAvx2(const char *p, char sep, std::uint64_t *masks)
   {
-      return _header;
+      const __m256i seps = _mm256_set1_epi8(sep);
+      const __m256i quotes = _mm256_set1_epi8('"');
+      const __m256i newlines = _mm256_set1_epi8('\n');
+      __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+      __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+
+      masks[0] = movemask32(lo, seps) | movemask32(hi, seps) << 32;
+      masks[1] = movemask32(lo, quotes) | movemask32(hi, quotes) << 32;
+      masks[2] = movemask32(lo, newlines) | movemask32(hi, newlines) << 32;
   }
 
-  const std::string Parser::getHeaderElement(unsigned int pos) const
+  static bool hasAvx2(void)
   {
-      if (pos >= _header.size())
-        throw Error("can't return this header (doesn't exist)");
-      return _header[pos];
+# ifdef _MSC_VER
+      int info[4];
+
+      __cpuid(info, 0);
+      if (info[0] < 7)
+        return false;
+      __cpuid(info, 1);
+      // the OS must save the ymm registers too
+      if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6)
+        return false;
+      __cpuidex(info, 7, 0);
+      return (info[1] & (1 << 5)) != 0;
+# else
+      return __builtin_cpu_supports("avx2");
+# endif
   }
+#endif
 
-  bool Parser::deleteRow(unsigned int pos)
+  static ClassifyFn classifier(void)
   {
-    if (pos < _content.size())
-    {
-      delete *(_content.begin() + pos);
-      _content.erase(_content.begin() + pos);
-      return true;
-    }
-    return false;
+#if CSV_X86
+      static const ClassifyFn fn = hasAvx2() ? classifyAvx2 : classifySse2;
+#else
+      static const ClassifyFn fn = classifyScalar;
+#endif
+      return fn;
   }
 
-  bool Parser::addRow(unsigned int pos, const std::vector<std::string> &r)
+  static unsigned int lowestBit(std::uint64_t mask)
   {
-    Row *row = new Row(_header);
+#if defined(_MSC_VER) && defined(_M_X64)
+      unsigned long pos;
 
-    for (auto it = r.begin(); it != r.end(); it++)
-      row->push(*it);
-    
-    if (pos <= _content.size())
-    {
-      _content.insert(_content.begin() + pos, row);
-      return true;
-    }
-    return false;
+      _BitScanForward64(&pos, mask);
+      return pos;
+#elif defined(_MSC_VER)
+      unsigned long pos;
+
+      if (_BitScanForward(&pos, static_cast<unsigned long>(mask)))
+        return pos;
+      _BitScanForward(&pos, static_cast<unsigned long>(mask >> 32));
+      return pos + 32;
+#else
+      return __builtin_ctzll(mask);
+#endif
   }
 
-  void Parser::sync(void) const
+  /*
+  ** Bit i of the result is the parity of the bits 0..i of `mask`, i.e. it
+  ** is set for every byte that follows an odd number of quotes.
+  */
+  static std::uint64_t prefixXor(std::uint64_t mask)
   {
-    if (_type == DataType::eFILE)
-    {
-      std::ofstream f;
-      f.open(_file, std::ios::out | std::ios::trunc);
+      mask ^= mask << 1;
+      mask ^= mask << 2;
+      mask ^= mask << 4;
+      mask ^= mask << 8;
+      mask ^= mask << 16;
+      mask ^= mask << 32;
+      return mask;
+  }
 
-      // header
-      unsigned int i = 0;
-      for (auto it = _header.begin(); it != _header.end(); it++)
+  FieldScanner::FieldScanner(std::string_view data, char sep)
+    : _data(data), _sep(sep), _pos(0), _lines(0), _block(std::string_view::npos)
+  {
+      _masks[0] = _masks[1] = _masks[2] = 0;
+  }
+
+  void FieldScanner::load(std::size_t block)
+  {
+      if (block == _block)
+        return;
+      _block = block;
+
+      std::size_t offset = block * 64;
+      if (offset + 64 <= _data.size())
+        classifier()(_data.data() + offset, _sep, _masks);
+      else
       {
-        f << *it;
-        if (i < _header.size() - 1)
-          f << ",";
-        else
-          f << std::endl;
-        i++;
+        // never read past the end of the input (it may end a mapping)
+        char tail[64];
+        std::size_t size = _data.size() - offset;
+
+        std::memcpy(tail, _data.data() + offset, size);
+        std::memset(tail + size, 0, 64 - size);
+        classifier()(tail, _sep, _masks);
+        std::uint64_t valid = (std::uint64_t(1) << size) - 1;
+        _masks[0] &= valid;
+        _masks[1] &= valid;
+        _masks[2] &= valid;
       }
-     
-      for (auto it = _content.begin(); it != _content.end(); it++)
-        f << **it << std::endl;
-      f.close();
-    }
   }
 
-  const std::string &Parser::getFileName(void) const
+  std::size_t FieldScanner::lines(void) const
   {
-      return _file;    
+      return _lines;
   }
-  
+
   /*
-  ** ROW
+  ** Find the next record: it ends at the next newline outside of quotes
+  ** or at the end of the input. `ends` receives the offset, relative to
+  ** the record, of the end of each field, the last one being its length.
   */
+  bool FieldScanner::next(std::string_view &record, std::vector<std::size_t> &ends)
+  {
+      if (_pos >= _data.size())
+        return false;
 
-  Row::Row(const std::vector<std::string> &header)
-      : _header(header) {}
+      std::size_t start = _pos;
+      std::uint64_t carry = 0;
 
-  Row::~Row(void) {}
+      ends.clear();
+      for (;;)
+      {
+        std::size_t block = _pos / 64;
+        std::size_t base = block * 64;
 
-  unsigned int Row::size(void) const
+        load(block);
+
+        std::uint64_t live = ~std::uint64_t(0) << (_pos - base);
+        std::uint64_t quoted = prefixXor(_masks[1] & live) ^ carry;
+        std::uint64_t delims = _masks[0] & live & ~quoted;
+        std::uint64_t stops = _masks[2] & live & ~quoted;
+        std::uint64_t embedded = _masks[2] & live & quoted;
+        std::size_t end = base + 64;
+
+        if (stops != 0)
+        {
+          unsigned int stop = lowestBit(stops);
+
+          delims &= (std::uint64_t(1) << stop) - 1;
+          embedded &= (std::uint64_t(1) << stop) - 1;
+          end = base + stop;
+        }
+        for (; delims != 0; delims &= delims - 1)
+          ends.push_back(base + lowestBit(delims) - start);
+        for (; embedded != 0; embedded &= embedded - 1)
+          _lines++;
+
+        if (stops != 0 || end >= _data.size())
+        {
+          // the input may also end right on a block boundary, newline-less
+          if (stops == 0)
+            end = _data.size();
+          else
+            _lines++;
+          ends.push_back(end - start);
+          record = _data.substr(start, end - start);
+          _pos = end + 1;
+          return true;
+        }
+        carry = (quoted >> 63) ? ~std::uint64_t(0) : 0;
+        _pos = end;
+      }
+  }
+
+  /*
+  ** Fill `row` with the loaded fields of a scanned record, either copied
+  ** into `copy` or, when it is null, as views into the record. Fields
+  ** outside the schema's projection are never copied. False (and `row`
+  ** left alone) if the record has not as many fields as the header.
+  */
+  static bool fillRow(std::string_view record, const std::vector<std::size_t> &ends,
+                      Row &row, std::pmr::memory_resource *copy)
   {
-    return _values.size();
+      const Schema &schema = row.getSchema();
+
+      // if value(s) missing
+      if (ends.size() != schema.size())
+          return false;
+
+      const std::vector<unsigned int> &columns = schema.columns();
+      row.reserve(columns.size());
+      for (auto it = columns.begin(); it != columns.end(); it++)
+      {
+          std::size_t tokenStart = *it == 0 ? 0 : ends[*it - 1] + 1;
+          std::string_view field = record.substr(tokenStart, ends[*it] - tokenStart);
+
+          if (copy != nullptr && !field.empty())
+          {
+              char *bytes = static_cast<char *>(copy->allocate(field.size(), 1));
+              std::memcpy(bytes, field.data(), field.size());
+              field = std::string_view(bytes, field.size());
+          }
+          row.pushView(field);
+      }
+      return true;
   }
 
-  void Row::push(const std::string &value)
+  void Parser::parseHeader(void)
   {
-    _values.push_back(value);
+      std::string_view line;
+      const char *begin = _data.data();
+
+      _contentLine = 1;
+      while (line.empty() && !_data.empty())
+      {
+          line = nextLine(_data);
+          _contentLine++;
+      }
+      _contentOffset = _data.data() - begin;
+      if (line.empty())
+      {
+        if (_type == ePURE)
+          throw Error(std::string("No Data in pure content"));
+        throw Error(std::string("No Data in ").append(_file));
+      }
+      _schema = splitHeader(line, _sep, _options);
   }
 
-  bool Row::set(const std::string &key, const std::string &value) 
+  /*
+  ** Run fn(0) .. fn(count - 1) on their own threads (fn(0) on the caller's).
+  ** fn must not throw.
+  */
+  template<typename F>
+  static void runParallel(unsigned int count, F fn)
   {
-    std::vector<std::string>::const_iterator it;
-    int pos = 0;
+      std::vector<std::thread> workers;
 
-    for (it = _header.begin(); it != _header.end(); it++)
-    {
-        if (key == *it)
+      for (unsigned int i = 1; i < count; i++)
+        workers.emplace_back(fn, i);
+      fn(0);
+      for (auto it = workers.begin(); it != workers.end(); it++)
+        it->join();
+  }
+
+  /*
+  ** Cut `data` into at most `count` pieces, each ending on a newline that
+  ** is outside of any quoted field, so the pieces can be tokenized apart.
+  ** The quote parity at each nominal cut is counted in parallel first.
+  */
+  static std::vector<std::string_view> splitChunks(std::string_view data, unsigned int count)
+  {
+      std::size_t step = data.size() / count;
+      std::vector<unsigned char> parity(count, 0);
+
+      runParallel(count - 1, [&](unsigned int i) {
+        std::string_view piece = data.substr(i * step, step);
+        parity[i + 1] = std::count(piece.begin(), piece.end(), '"') & 1;
+      });
+      for (unsigned int i = 1; i < count; i++)
+        parity[i] ^= parity[i - 1];
+
+      std::vector<std::string_view> chunks;
+      std::size_t start = 0;
+
+      for (unsigned int i = 1; i < count && start < data.size(); i++)
+      {
+        std::size_t pos = i * step;
+        bool quoted = parity[i] != 0;
+
+        // the previous cut ran past this one: a cut is never inside quotes
+        if (pos < start)
         {
-          _values[pos] = value;
-          return true;
+          pos = start;
+          quoted = false;
+        }
+        for (; pos != data.size(); pos++)
+        {
+          if (data[pos] == '"')
+            quoted = !quoted;
+          else if (data[pos] == '\n' && !quoted)
+            break;
         }
-        pos++;
+        if (pos == data.size())
+          break;
+        chunks.push_back(data.substr(start, pos + 1 - start));
+        start = pos + 1;
+      }
+      chunks.push_back(data.substr(start));
+      return chunks;
+  }
+
+  /*
+  ** Upstream of the parser arenas when Options::hugePages is set: whole
+  ** 2 MiB-aligned blocks of pages, which the kernel is asked to back with
+  ** transparent huge pages (large pages on Windows, when the process has
+  ** the privilege). Falls back to operator new where neither exists.
+  */
+  class HugePageResource : public std::pmr::memory_resource
+  {
+    static const std::size_t PAGE = 2 << 20;
+
+    static std::size_t round(std::size_t bytes)
+    {
+      return (bytes + PAGE - 1) / PAGE * PAGE;
     }
-    return false;
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+      if (alignment > PAGE)
+        throw std::bad_alloc();
+      bytes = round(bytes);
+#if defined(_WIN32)
+      void *addr = nullptr;
+      SIZE_T large = GetLargePageMinimum();
+      if (large != 0 && bytes % large == 0)
+        addr = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+      if (addr == nullptr)
+        addr = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+      if (addr == nullptr)
+        throw std::bad_alloc();
+      return addr;
+#elif defined(MAP_ANONYMOUS)
+      // over-map by a page, then trim down to an aligned block
+      void *addr = mmap(nullptr, bytes + PAGE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (addr == MAP_FAILED)
+        throw std::bad_alloc();
+
+      char *raw = static_cast<char *>(addr);
+      char *block = reinterpret_cast<char *>(
+          (reinterpret_cast<std::uintptr_t>(raw) + PAGE - 1) / PAGE * PAGE);
+      if (block != raw)
+        munmap(raw, block - raw);
+      munmap(block + bytes, raw + PAGE - block);
+# ifdef MADV_HUGEPAGE
+      madvise(block, bytes, MADV_HUGEPAGE);
+# endif
+      return block;
+#else
+      return ::operator new(bytes, std::align_val_t(alignment));
+#endif
+    }
+
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override
+    {
+#if defined(_WIN32)
+      (void)bytes;
+      (void)alignment;
+      VirtualFree(p, 0, MEM_RELEASE);
+#elif defined(MAP_ANONYMOUS)
+      (void)alignment;
+      munmap(p, round(bytes));
+#else
+      ::operator delete(p, std::align_val_t(alignment));
+#endif
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+      return this == &other;
+    }
+  };
+
+  /*
+  ** A new arena for the rows of about `bytes` of input: a single thread
+  ** allocates from it, so it needs no locking.
+  */
+  std::pmr::memory_resource &Parser::newArena(std::size_t bytes)
+  {
+     static HugePageResource hugePages;
+     std::pmr::memory_resource *upstream = _options.hugePages
+        ? static_cast<std::pmr::memory_resource *>(&hugePages)
+        : std::pmr::get_default_resource();
+
+     // a row costs about as much as its text again: a first block that
+     // fits most inputs, growing geometrically if it does not
+     _arenas.emplace_back(new std::pmr::monotonic_buffer_resource(
+        std::max<std::size_t>(2 * bytes, 4096), upstream));
+     return *_arenas.back();
   }
 
-  const std::string Row::operator[](unsigned int valuePosition) const
+  /*
+  ** Parse the records of `data` into `rows`, the malformed ones into
+  ** `rejected` (with lines counted from the start of `data`) when lenient.
+  ** Returns the number of lines of `data`.
+  */
+  std::size_t Parser::parseRange(std::string_view data, std::vector<Row *> &rows,
+                                 std::pmr::memory_resource &arena,
+                                 std::vector<Rejected> &rejected) const
   {
-       if (valuePosition < _values.size())
-           return _values[valuePosition];
-       throw Error("can't return this value (doesn't exist)");
+     FieldScanner scanner(data, _sep);
+     std::string_view line;
+     std::vector<std::size_t> ends;
+     // an eMMAP row views the mapping, the others copy their fields
+     std::pmr::memory_resource *copy = _type == eMMAP ? nullptr : &arena;
+
+     std::size_t first = 0;
+     while (scanner.next(line, ends))
+     {
+         if (!line.empty())
+         {
+           if (ends.size() != _schema->size())
+           {
+             if (!_options.lenient)
+               throw Error("corrupted data !");
+             Rejected bad = { static_cast<unsigned long>(first),
+                              static_cast<std::uint64_t>(line.data() - _data.data()),
+                              ends.size(), std::string(line) };
+             rejected.push_back(bad);
+           }
+           else
+           {
+             Row *row = new (arena.allocate(sizeof(Row), alignof(Row))) Row(*_schema, &arena);
+
+             fillRow(line, ends, *row, copy);
+             rows.push_back(row);
+           }
+         }
+         first = scanner.lines();
+     }
+     return scanner.lines();
   }
 
-  const std::string Row::operator[](const std::string &key) const
+  void Parser::parseContent(void)
+  {
+     unsigned int threads = _options.threads;
+
+     if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+     // not worth a thread below 64k per chunk
+     threads = std::min<std::size_t>(threads, _data.size() / 65536 + 1);
+
+     std::vector<std::string_view> chunks = threads > 1
+        ? splitChunks(_data, threads)
+        : std::vector<std::string_view>(1, _data);
+     std::vector<std::vector<Row *> > parts(chunks.size());
+     std::vector<std::vector<Rejected> > rejected(chunks.size());
+     std::vector<std::size_t> lines(chunks.size());
+     std::vector<std::exception_ptr> errors(chunks.size());
+     std::vector<std::pmr::memory_resource *> arenas;
+
+     for (auto it = chunks.begin(); it != chunks.end(); it++)
+         arenas.push_back(&newArena(it->size()));
+     runParallel(chunks.size(), [&](unsigned int i) {
+         try
+         {
+             lines[i] = parseRange(chunks[i], parts[i], *arenas[i], rejected[i]);
+         }
+         catch (...)
+         {
+             errors[i] = std::current_exception();
+         }
+     });
+
+     // stitch the pieces back in file order
+     std::size_t total = 0;
+     for (auto it = parts.begin(); it != parts.end(); it++)
+         total += it->size();
+     std::vector<Row *> rows;
+     rows.reserve(total);
+     for (auto it = parts.begin(); it != parts.end(); it++)
+         rows.insert(rows.end(), it->begin(), it->end());
+     _content.assign(rows);
+
+     // chunk lines and offsets (from the start of the content) to file ones
+     std::size_t line = _contentLine;
+     for (unsigned int i = 0; i < chunks.size(); i++)
+     {
+         for (auto it = rejected[i].begin(); it != rejected[i].end(); it++)
+         {
+             it->line += line;
+             it->offset += _contentOffset;
+             _rejected.push_back(*it);
+         }
+         line += lines[i];
+     }
+
+     for (auto it = errors.begin(); it != errors.end(); it++)
+         if (*it)
+         {
+             _content.clear();
+             std::rethrow_exception(*it);
+         }
+  }
+
+  /*
+  ** Start of every non-empty record, in one memchr pass. A line with an
+  ** odd number of quotes goes on with the next one (a quoted newline).
+  */
+  void Parser::indexLines(void)
   {
-      std::vector<std::string>::const_iterator it;
-      int pos = 0;
+      const char *begin = _data.data();
+      const char *end = begin + _data.size();
+      const char *record = begin;
+      bool quoted = false;
 
-      for (it = _header.begin(); it != _header.end(); it++)
+      for (const char *line = begin; line < end; )
       {
-          if (key == *it)
-              return _values[pos];
-          pos++;
+        const char *newline = static_cast<const char *>(std::memchr(line, '\n', end - line));
+        if (newline == nullptr)
+          newline = end;
+        quoted ^= std::count(line, newline, '"') & 1;
+        line = newline + 1;
+        if (quoted)
+          continue;
+        if (newline != record)
+          _lines.push_back(record - begin);
+        record = line;
       }
-      
-      throw Error("can't return this value (doesn't exist)");
+      if (quoted && record < end)
+        _lines.push_back(record - begin);
   }
 
-  std::ostream &operator<<(std::ostream &os, const Row &row)
+  /*
+  ** Row `pos` of a lazy parser, split on the first call and then kept
+  ** while it is among the last `cacheRows` used.
+  */
+  Row &Parser::lazyRow(unsigned int pos) const
   {
-      for (unsigned int i = 0; i != row._values.size(); i++)
-          os << row._values[i] << " | ";
+      auto hit = _cached.find(pos);
+      if (hit != _cached.end())
+      {
+        _cache.splice(_cache.begin(), _cache, hit->second);
+        return *hit->second->second;
+      }
 
-      return os;
+      // reuse the least recently used row once the cache is full
+      std::unique_ptr<Row> row;
+      if (!_cache.empty() && _cache.size() >= _options.cacheRows)
+      {
+        _cached.erase(_cache.back().first);
+        row = std::move(_cache.back().second);
+        _cache.pop_back();
+        row->clear();
+      }
+      else
+        row.reset(new Row(*_schema));
+
+      std::string_view record;
+      std::vector<std::size_t> ends;
+      FieldScanner scanner(_data.substr(_lines[pos]), _sep);
+      scanner.next(record, ends);
+      // not known to be malformed before being split: no way to skip it now
+      if (!fillRow(record, ends, *row, nullptr))
+        throw Error("corrupted data !");
+
+      _cache.emplace_front(pos, std::move(row));
+      _cached[pos] = _cache.begin();
+      return *_cache.front().second;
   }
 
-  std::ofstream &operator<<(std::ofstream &os, const Row &row)
+  Row &Parser::getRow(unsigned int rowPosition) const
+  {
+      if (rowPosition < rowCount())
+          return _options.lazy ? lazyRow(rowPosition) : *_content.at(rowPosition);
+      throw Error("can't return this row (doesn't exist)");
+  }
+
+  RowStore::Handle Parser::rowHandle(unsigned int rowPosition) const
+  {
+      if (rowPosition < rowCount())
+          return _options.lazy ? rowPosition : _content.handleAt(rowPosition);
+      throw Error("can't return this row (doesn't exist)");
+  }
+
+  int Parser::rowPosition(RowStore::Handle handle) const
+  {
+      if (_options.lazy)
+          return handle < _lines.size() ? static_cast<int>(handle) : -1;
+      return _content.positionOf(handle);
+  }
+
+  Row &Parser::operator[](unsigned int rowPosition) const
   {
-    for (unsigned int i = 0; i != row._values.size(); i++)
+      return Parser::getRow(rowPosition);
+  }
+
+  unsigned int Parser::rowCount(void) const
+  {
+      return _options.lazy ? _lines.size() : _content.size();
+  }
+
+  unsigned int Parser::columnCount(void) const
+  {
+      return _schema->size();
+  }
+
+  std::vector<std::string> Parser::getHeader(void) const
+  {
+      return _schema->names();
+  }
+
+  std::shared_ptr<const Schema> Parser::getSchema(void) const
+  {
+      return _schema;
+  }
+
+  const std::vector<Rejected> &Parser::getRejected(void) const
+  {
+      return _rejected;
+  }
+
+  const std::string Parser::getHeaderElement(unsigned int pos) const
+  {
+      if (pos >= _schema->size())
+        throw Error("can't return this header (doesn't exist)");
+      return _schema->names()[pos];
+  }
+
+  bool Parser::deleteRow(unsigned int pos)
+  {
+    if (!_options.lazy && pos < _content.size())
     {
-        os << row._values[i];
-        if (i < row._values.size() - 1)
-          os << ",";
+      // its memory goes back with the arena
+      _content.erase(pos);
+      if (_options.journal)
+        _pending.append("-").append(std::to_string(pos)).append("\n");
+      return true;
     }
-    return os;
+    return false;
+  }
+
+  bool Parser::addRow(unsigned int pos, const std::vector<std::string> &r)
+  {
+    if (_options.lazy || pos > _content.size())
+      return false;
+
+    std::pmr::memory_resource &arena = *_arenas.back();
+    Row *row = new (arena.allocate(sizeof(Row), alignof(Row))) Row(*_schema, &arena);
+    const std::vector<unsigned int> &columns = _schema->columns();
+
+    for (auto it = columns.begin(); it != columns.end() && *it < r.size(); it++)
+      row->push(r[*it]);
+    
+    _content.insert(pos, row);
+    if (_options.journal)
+    {
+      _pending.append("+").append(std::to_string(pos)).append(" ")
+              .append(std::to_string(r.size())).append("\n");
+      for (auto it = r.begin(); it != r.end(); it++)
+        _pending.append(std::to_string(it->size())).append(":").append(*it);
+      _pending.append("\n");
+    }
+    return true;
+  }
+
+  void Parser::sync(void) const
+  {
+    if (_type != DataType::eFILE && _type != DataType::eMMAP)
+      return;
+    if (_options.lazy)
+      throw Error("can't sync a lazily loaded file");
+    if (!_options.journal)
+    {
+      compact();
+      return;
+    }
+    if (_schema->columns().size() != _schema->size())
+      throw Error("can't sync a file loaded with some columns only");
+    if (_pending.empty())
+      return;
+
+    // once the journal outgrows the file, replaying it costs more than a rewrite
+    std::uint64_t size;
+    std::int64_t time;
+    if (!fileStamp(_file, size, time) || _journalSize + _pending.size() > size)
+    {
+      compact();
+      return;
+    }
+
+    // a new journal starts with the stamp of the file
+    std::string path = journalPath();
+    std::string header = _journalSize == 0 ? journalHeader(size, time) : std::string();
+    std::ofstream f(path, std::ios::out | std::ios::binary
+                    | (header.empty() ? std::ios::app : std::ios::trunc));
+    f.write(header.data(), header.size());
+    f.write(_pending.data(), _pending.size());
+    f.flush();
+    if (!f)
+      throw Error(std::string("Failed to write ").append(path));
+    _journalSize += header.size() + _pending.size();
+    _pending.clear();
+  }
+
+  void Parser::compact(void) const
+  {
+    if (_type != DataType::eFILE && _type != DataType::eMMAP)
+      return;
+    if (_options.lazy)
+      throw Error("can't sync a lazily loaded file");
+    if (_schema->columns().size() != _schema->size())
+      throw Error("can't sync a file loaded with some columns only");
+
+    if (_type == DataType::eMMAP)
+    {
+      // the rows must not point into the file being replaced
+      for (unsigned int i = 0; i < _content.size(); i++)
+        _content.at(i)->materialize();
+      _map.close();
+    }
+
+    // written aside then renamed over the file, which is never half written
+    std::string temporary = _file + ".tmp";
+    {
+      std::vector<char> buffer(1 << 16);
+      std::ofstream f;
+      f.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+      f.open(temporary, std::ios::out | std::ios::trunc);
+
+      // header
+      const std::vector<std::string> &header = _schema->names();
+      for (unsigned int i = 0; i < header.size(); i++)
+      {
+        f << header[i];
+        f << (i < header.size() - 1 ? ',' : '\n');
+      }
+
+      for (unsigned int i = 0; i < _content.size(); i++)
+        f << *_content.at(i) << '\n';
+      f.flush();
+      if (!f)
+      {
+        f.close();
+        std::remove(temporary.c_str());
+        throw Error(std::string("Failed to write ").append(temporary));
+      }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temporary, _file, ec);
+    if (ec)
+    {
+      std::remove(temporary.c_str());
+      throw Error(std::string("Failed to replace ").append(_file));
+    }
+    std::remove(journalPath().c_str());
+    _journalSize = 0;
+    _pending.clear();
+  }
+
+  /*
+  ** JOURNAL
+  **
+  ** "<file>.journal" starts with the stamp of the file it applies to,
+  ** "CSVJOURNAL 1 <size> <time>\n", followed by the changes in order:
+  ** "-<pos>\n" for a deleted row, "+<pos> <count>\n" then every field as
+  ** "<length>:<bytes>" and a final "\n" for an added one. A journal whose
+  ** stamp is not the file's predates the last rewrite and is dropped.
+  */
+
+  std::string Parser::journalPath(void) const
+  {
+      return _file + ".journal";
+  }
+
+  void Parser::replayJournal(void)
+  {
+      std::string path = journalPath();
+      std::ifstream in(path, std::ios::binary);
+      if (!in.is_open())
+        return;
+      std::string journal((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+      in.close();
+
+      std::uint64_t size;
+      std::int64_t time;
+      std::string header;
+      if (fileStamp(_file, size, time))
+        header = journalHeader(size, time);
+
+      std::string_view rest(journal);
+      if (header.empty() || rest.compare(0, header.size(), header) != 0)
+      {
+        std::remove(path.c_str());
+        return;
+      }
+      rest.remove_prefix(header.size());
+
+      // replay up to the last whole entry: a sync may have been cut short
+      std::string_view entry = rest;
+      std::vector<std::string> fields;
+      std::size_t pos, count, length;
+      while (!rest.empty())
+      {
+        entry = rest;
+        char op = rest.front();
+        rest.remove_prefix(1);
+        if (op == '-')
+        {
+          if (!readCount(rest, pos, '\n'))
+            break;
+          if (!deleteRow(pos))
+            throw Error(std::string("corrupted journal ").append(path));
+        }
+        else if (op == '+')
+        {
+          if (!readCount(rest, pos, ' ') || !readCount(rest, count, '\n'))
+            break;
+          fields.clear();
+          while (fields.size() < count && readCount(rest, length, ':') && length <= rest.size())
+          {
+            fields.emplace_back(rest.substr(0, length));
+            rest.remove_prefix(length);
+          }
+          if (fields.size() < count || rest.empty() || rest.front() != '\n')
+            break;
+          rest.remove_prefix(1);
+          if (!addRow(pos, fields))
+            throw Error(std::string("corrupted journal ").append(path));
+        }
+        else
+          throw Error(std::string("corrupted journal ").append(path));
+        entry = rest;
+      }
+
+      // drop a torn last entry so that later ones are appended after whole ones
+      _journalSize = journal.size() - entry.size();
+      if (!entry.empty())
+      {
+        std::error_code ec;
+        std::filesystem::resize_file(path, _journalSize, ec);
+      }
+      _pending.clear();
+  }
+
+  const std::string &Parser::getFileName(void) const
+  {
+      return _file;    
+  }
+  
+  /*
+  ** READER
+  */
+
+  Reader::Reader(const std::string &path, char sep, const Options &options)
+    : _path(path != "-" ? path : ""), _in(&std::cin), _sep(sep), _options(options),
+      _buffer(options.bufferSize > 0 ? options.bufferSize : 1),
+      _begin(0), _end(0), _eof(false), _lineNumber(0), _offset(0),
+      _recordLine(0), _recordOffset(0)
+  {
+      if (path != "-")
+      {
+        _file.open(path.c_str(), std::ios::in | std::ios::binary);
+        if (!_file.is_open())
+          throw Error(std::string("Failed to open ").append(path));
+        _in = &_file;
+      }
+      readHeader(path);
+  }
+
+  Reader::Reader(std::istream &in, char sep, const Options &options)
+    : _in(&in), _sep(sep), _options(options),
+      _buffer(options.bufferSize > 0 ? options.bufferSize : 1),
+      _begin(0), _end(0), _eof(false), _lineNumber(0), _offset(0),
+      _recordLine(0), _recordOffset(0)
+  {
+      readHeader("stream");
+  }
+
+  Reader::~Reader(void) {}
+
+  void Reader::readHeader(const std::string &name)
+  {
+      std::string_view line;
+
+      while (line.empty())
+        if (!readLine(line))
+          throw Error(std::string("No Data in ").append(name));
+      _schema = splitHeader(line, _sep, _options);
+      _row.reset(new Row(*_schema));
+  }
+
+  /*
+  ** Hand out the next record of the buffer (a line, or several when a
+  ** quoted field holds newlines), refilling it from the stream when no
+  ** complete record is left. The buffer only grows for a record longer
+  ** than itself.
+  */
+  bool Reader::readLine(std::string_view &line)
+  {
+      // bytes of the record already searched, and whether they end in quotes
+      std::size_t scanned = 0;
+      bool quoted = false;
+      unsigned long lines = 0;
+
+      for (;;)
+      {
+        const char *begin = _buffer.data() + _begin;
+        const char *from = begin + scanned;
+        const char *nl = static_cast<const char *>(std::memchr(from, '\n', _end - _begin - scanned));
+
+        if (nl != nullptr)
+        {
+          quoted ^= std::count(from, nl, '"') & 1;
+          lines++;
+          scanned = nl - begin + 1;
+          if (quoted)
+            continue;
+          line = std::string_view(begin, nl - begin);
+          _begin += scanned;
+          _offset += scanned;
+          _lineNumber += lines;
+          return true;
+        }
+        if (_eof)
+        {
+          if (_begin == _end)
+            return false;
+          // last record without a trailing newline
+          line = std::string_view(begin, _end - _begin);
+          _offset += _end - _begin;
+          _begin = _end;
+          _lineNumber += lines + 1;
+          return true;
+        }
+
+        // keep the partial record, make room behind it and read more
+        if (_begin > 0)
+        {
+          std::memmove(_buffer.data(), begin, _end - _begin);
+          _end -= _begin;
+          _begin = 0;
+        }
+        if (_end == _buffer.size())
+          _buffer.resize(_buffer.size() * 2);
+
+        _in->read(_buffer.data() + _end, _buffer.size() - _end);
+        _end += _in->gcount();
+        if (!_in->good())
+          _eof = true;
+      }
+  }
+
+  /*
+  ** Split the next record into _ends, skipping (or throwing on) those
+  ** without as many fields as the header.
+  */
+  bool Reader::nextRecord(std::string_view &record)
+  {
+      for (;;)
+      {
+        _recordLine = _lineNumber + 1;
+        _recordOffset = _offset;
+        if (!readLine(record))
+          return false;
+        if (record.empty())
+          continue;
+
+        FieldScanner scanner(record, _sep);
+
+        scanner.next(record, _ends);
+        if (_ends.size() == _schema->size())
+          return true;
+        reject(record);
+      }
+  }
+
+  void Reader::reject(std::string_view record)
+  {
+      if (!_options.lenient)
+        throw Error("corrupted data !");
+
+      Rejected bad = { _recordLine, _recordOffset, _ends.size(), std::string(record) };
+      _rejected.push_back(bad);
+  }
+
+  const Row *Reader::next(void)
+  {
+      std::string_view record;
+
+      if (!nextRecord(record))
+        return nullptr;
+      _row->clear();
+      fillRow(record, _ends, *_row, nullptr);
+      return _row.get();
+  }
+
+  std::vector<std::string> Reader::getHeader(void) const
+  {
+      return _schema->names();
+  }
+
+  std::shared_ptr<const Schema> Reader::getSchema(void) const
+  {
+      return _schema;
+  }
+
+  const std::vector<Rejected> &Reader::getRejected(void) const
+  {
+      return _rejected;
+  }
+
+  unsigned long Reader::lineNumber(void) const
+  {
+      return _lineNumber;
+  }
+
+  Position Reader::position(void) const
+  {
+      Position here;
+
+      here.offset = _offset;
+      here.line = _lineNumber;
+      return here;
+  }
+
+  std::size_t Reader::rowEstimate(void) const
+  {
+      std::error_code error;
+      std::uint64_t size = _path.empty() ? 0 : std::filesystem::file_size(_path, error);
+
+      if (error || size <= _offset)
+        return 0;
+
+      // the lines already in the buffer stand for the rest of the file
+      const char *begin = _buffer.data() + _begin;
+      std::size_t bytes = _end - _begin;
+      std::size_t lines = std::count(begin, begin + bytes, '\n');
+      if (lines == 0)
+        return 1;
+      return static_cast<std::size_t>((size - _offset) * lines / bytes);
+  }
+
+  Follower::Follower(const std::string &path, char sep, const Options &options)
+    : _path(path), _sep(sep), _options(options), _begin(0), _scanned(0),
+      _quoted(false), _scannedLines(0), _lineNumber(0), _read(0), _offset(0),
+      _recordLine(0), _recordOffset(0)
+  {}
+
+  Follower::~Follower(void) {}
+
+  /*
+  ** Read what the file gained since the last call, at most a buffer's
+  ** worth, behind the bytes not handed out yet. False if nothing was added.
+  */
+  bool Follower::fill(void)
+  {
+      std::error_code error;
+      std::uint64_t size = std::filesystem::file_size(_path, error);
+
+      if (error)
+        return false;
+      if (size < _read)
+      {
+        // truncated or replaced: start over with a new header
+        _file.close();
+        _buffer.clear();
+        _begin = _scanned = 0;
+        _quoted = false;
+        _scannedLines = _lineNumber = 0;
+        _read = _offset = 0;
+        _row.reset();
+        _schema.reset();
+      }
+      if (size == _read)
+        return false;
+      if (!_file.is_open())
+      {
+        _file.open(_path, std::ios::binary);
+        if (!_file.is_open())
+          return false;
+      }
+
+      std::size_t chunk = static_cast<std::size_t>(
+        std::min<std::uint64_t>(size - _read, std::max<std::size_t>(_options.bufferSize, 1)));
+
+      _buffer.erase(0, _begin);
+      _begin = 0;
+      std::size_t kept = _buffer.size();
+      _buffer.resize(kept + chunk);
+      // the stream stopped at the old end of file last time
+      _file.clear();
+      _file.seekg(static_cast<std::streamoff>(_read));
+      _file.read(&_buffer[kept], chunk);
+      _buffer.resize(kept + _file.gcount());
+      _read += _file.gcount();
+      return _file.gcount() > 0;
+  }
+
+  /*
+  ** Hand out the next complete record read so far; unlike Reader, a last
+  ** record without its newline is left for later since the writer may not
+  ** be done with it.
+  */
+  bool Follower::readLine(std::string_view &line)
+  {
+      const char *begin = _buffer.data() + _begin;
+      std::size_t size = _buffer.size() - _begin;
+
+      while (_scanned < size)
+      {
+        const char *from = begin + _scanned;
+        const char *nl = static_cast<const char *>(std::memchr(from, '\n', size - _scanned));
+
+        if (nl == nullptr)
+        {
+          _quoted ^= std::count(from, begin + size, '"') & 1;
+          _scanned = size;
+          break;
+        }
+        _quoted ^= std::count(from, nl, '"') & 1;
+        _scannedLines++;
+        _scanned = nl - begin + 1;
+        if (_quoted)
+          continue;
+        line = std::string_view(begin, nl - begin);
+        _begin += _scanned;
+        _offset += _scanned;
+        _lineNumber += _scannedLines;
+        _scanned = 0;
+        _scannedLines = 0;
+        return true;
+      }
+      return false;
+  }
+
+  /*
+  ** Split the next record added into _ends, reading the header first and
+  ** skipping (or throwing on) records without as many fields as it.
+  */
+  bool Follower::nextRecord(std::string_view &record)
+  {
+      for (;;)
+      {
+        _recordLine = _lineNumber + 1;
+        _recordOffset = _offset;
+        if (!readLine(record))
+        {
+          if (!fill())
+            return false;
+          continue;
+        }
+        if (record.empty())
+          continue;
+        if (!_schema)
+        {
+          _schema = splitHeader(record, _sep, _options);
+          _row.reset(new Row(*_schema));
+          if (_resume.offset > _offset)
+          {
+            // the records before it were read already: go on from there
+            // (fill() starts over if the file is shorter by now)
+            _buffer.clear();
+            _begin = 0;
+            _read = _offset = _resume.offset;
+            _lineNumber = _resume.line;
+          }
+          _resume = Position();
+          continue;
+        }
+
+        FieldScanner scanner(record, _sep);
+
+        scanner.next(record, _ends);
+        if (_ends.size() == _schema->size())
+          return true;
+        reject(record);
+      }
+  }
+
+  void Follower::reject(std::string_view record)
+  {
+      if (!_options.lenient)
+        throw Error("corrupted data !");
+
+      Rejected bad = { _recordLine, _recordOffset, _ends.size(), std::string(record) };
+      _rejected.push_back(bad);
+  }
+
+  const Row *Follower::next(void)
+  {
+      std::string_view record;
+
+      if (!nextRecord(record))
+        return nullptr;
+      _row->clear();
+      fillRow(record, _ends, *_row, nullptr);
+      return _row.get();
+  }
+
+  std::shared_ptr<const Schema> Follower::getSchema(void) const
+  {
+      return _schema;
+  }
+
+  const std::vector<Rejected> &Follower::getRejected(void) const
+  {
+      return _rejected;
+  }
+
+  unsigned long Follower::lineNumber(void) const
+  {
+      return _lineNumber;
+  }
+
+  std::uint64_t Follower::offset(void) const
+  {
+      return _offset;
+  }
+
+  void Follower::resume(const Position &from)
+  {
+      _resume = from;
+  }
+
+  std::vector<std::string> listFiles(const std::vector<std::string> &paths,
+                                     const std::string &extension)
+  {
+      std::vector<std::string> files;
+
+      for (auto it = paths.begin(); it != paths.end(); it++)
+      {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(*it, ec))
+        {
+          files.push_back(*it);
+          continue;
+        }
+
+        std::vector<std::string> found;
+        for (std::filesystem::directory_iterator entry(*it, ec), end; !ec && entry != end; entry.increment(ec))
+          if (entry->is_regular_file(ec) && entry->path().extension() == extension)
+            found.push_back(entry->path().string());
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+      }
+      return files;
+  }
+
+  /*
+  ** COLUMN TABLE
+  */
+
+  ColumnTable::ColumnTable(const std::string &path, const std::vector<ColumnType> &types,
+                           char sep, const Options &options)
+    : _rows(0)
+  {
+      Reader reader(path, sep, options);
+
+      _schema = reader.getSchema();
+      _columns.resize(_schema->columns().size());
+      for (unsigned int i = 0; i != _columns.size(); i++)
+        _columns[i].type = _schema->columns()[i] < types.size() ? types[_schema->columns()[i]] : eAUTO;
+      while (const Row *row = reader.next())
+        append(*row);
+      finish();
+  }
+
+  ColumnTable::ColumnTable(const Parser &parser, const std::vector<ColumnType> &types)
+    : _schema(parser.getSchema()), _rows(0)
+  {
+      _columns.resize(_schema->columns().size());
+      for (unsigned int i = 0; i != _columns.size(); i++)
+        _columns[i].type = _schema->columns()[i] < types.size() ? types[_schema->columns()[i]] : eAUTO;
+      for (unsigned int i = 0; i != parser.rowCount(); i++)
+        append(parser.getRow(i));
+      finish();
+  }
+
+  ColumnTable::~ColumnTable(void) {}
+
+  void ColumnTable::append(const Row &row)
+  {
+      const std::vector<unsigned int> &columns = _schema->columns();
+
+      for (unsigned int i = 0; i != _columns.size(); i++)
+      {
+        Column &col = _columns[i];
+        std::string_view value = row.view(columns[i]);
+        double number;
+        Money amount;
+        bool ok = true;
+
+        switch (col.type)
+        {
+          case eNUMBER:
+            ok = toDouble(value, number);
+            break;
+          case eCURRENCY:
+            ok = toMoney(value, amount);
+            // the nearest double to the amount, as toCurrency reads it
+            number = amount.toDouble();
+            col.amounts.push_back(amount);
+            break;
+          case ePERCENT:
+            ok = toPercent(value, number);
+            break;
+          default:
+            // text, or kept as text until the type is known
+            col.bytes.append(value.data(), value.size());
+            col.ends.push_back(col.bytes.size());
+            continue;
+        }
+        if (!ok)
+          throw Error("can't convert this value");
+        col.numbers.push_back(number);
+      }
+      _rows++;
+  }
+
+  /*
+  ** Settle the type of the eAUTO columns, converting their text if it
+  ** is all numbers.
+  */
+  void ColumnTable::finish(void)
+  {
+      for (auto col = _columns.begin(); col != _columns.end(); col++)
+      {
+        if (col->type != eAUTO)
+          continue;
+
+        bool (*convert)(std::string_view, double &) = toDouble;
+        ColumnType type = eNUMBER;
+        if (col->bytes.find('$') != std::string::npos)
+        {
+          convert = toCurrency;
+          type = eCURRENCY;
+        }
+        else if (col->bytes.find('%') != std::string::npos)
+        {
+          convert = toPercent;
+          type = ePERCENT;
+        }
+
+        std::vector<double> numbers;
+        std::vector<Money> amounts;
+        std::size_t start = 0;
+        bool numeric = true;
+        numbers.reserve(_rows);
+        for (auto end = col->ends.begin(); numeric && end != col->ends.end(); end++)
+        {
+          std::string_view value = std::string_view(col->bytes).substr(start, *end - start);
+          double number;
+          Money amount;
+
+          numeric = convert(value, number);
+          numbers.push_back(number);
+          // money is kept in cents as long as it is whole cents
+          if (type == eCURRENCY && numeric)
+          {
+            if (toMoney(value, amount))
+              amounts.push_back(amount);
+            else
+              type = eNUMBER;
+          }
+          start = *end;
+        }
+
+        if (!numeric)
+          col->type = eTEXT;
+        else
+        {
+          col->type = type;
+          col->numbers.swap(numbers);
+          if (type == eCURRENCY)
+            col->amounts.swap(amounts);
+          std::string().swap(col->bytes);
+          std::vector<std::size_t>().swap(col->ends);
+        }
+      }
+  }
+
+  const ColumnTable::Column &ColumnTable::column(unsigned int column) const
+  {
+      int slot = _schema->slotOf(column);
+
+      if (slot < 0)
+        throw Error("can't return this column (doesn't exist)");
+      return _columns[slot];
+  }
+
+  unsigned int ColumnTable::rowCount(void) const
+  {
+      return _rows;
+  }
+
+  unsigned int ColumnTable::columnCount(void) const
+  {
+      return _schema->size();
+  }
+
+  const Schema &ColumnTable::getSchema(void) const
+  {
+      return *_schema;
+  }
+
+  ColumnType ColumnTable::getType(unsigned int col) const
+  {
+      return column(col).type;
+  }
+
+  const std::vector<double> &ColumnTable::numbers(unsigned int col) const
+  {
+      const Column &c = column(col);
+
+      if (c.type == eTEXT)
+        throw Error("can't return numbers of a text column");
+      return c.numbers;
+  }
+
+  const std::vector<Money> &ColumnTable::amounts(unsigned int col) const
+  {
+      const Column &c = column(col);
+
+      if (c.type != eCURRENCY)
+        throw Error("can't return amounts of a column that is not money");
+      return c.amounts;
+  }
+
+  std::string_view ColumnTable::text(unsigned int col, unsigned int row) const
+  {
+      const Column &c = column(col);
+
+      if (c.type != eTEXT)
+        throw Error("can't return text of a numeric column");
+      if (row >= _rows)
+        throw Error("can't return this value (doesn't exist)");
+
+      std::size_t start = row == 0 ? 0 : c.ends[row - 1];
+      return std::string_view(c.bytes).substr(start, c.ends[row] - start);
+  }
+
+  double ColumnTable::sum(unsigned int col) const
+  {
+      const std::vector<double> &values = numbers(col);
+      // independent partial sums, so the loop is not one long dependency chain
+      double partial[4] = { 0, 0, 0, 0 };
+      std::size_t i = 0;
+
+      for (; i + 4 <= values.size(); i += 4)
+      {
+        partial[0] += values[i];
+        partial[1] += values[i + 1];
+        partial[2] += values[i + 2];
+        partial[3] += values[i + 3];
+      }
+      for (; i != values.size(); i++)
+        partial[0] += values[i];
+      return (partial[0] + partial[1]) + (partial[2] + partial[3]);
+  }
+
+  std::vector<unsigned int> ColumnTable::filter(unsigned int col, std::string_view value) const
+  {
+      const Column &c = column(col);
+      std::vector<unsigned int> rows;
+
+      if (c.type != eTEXT)
+        throw Error("can't filter a numeric column on text");
+
+      std::string_view bytes = c.bytes;
+      std::size_t start = 0;
+      for (unsigned int row = 0; row != _rows; row++)
+      {
+        std::size_t end = c.ends[row];
+
+        if (end - start == value.size() && bytes.compare(start, value.size(), value) == 0)
+          rows.push_back(row);
+        start = end;
+      }
+      return rows;
+  }
+
+  /*
+  ** SNAPSHOT
+  */
+
+  namespace
+  {
+    // on-disk header of a snapshot, in the byte order of the machine
+    struct SnapshotHeader
+    {
+      char magic[8];
+      std::uint32_t version;
+      std::uint32_t byteOrder;
+      std::uint32_t texts;
+      std::uint32_t numbers;
+      std::uint32_t integers;
+      std::uint32_t reserved;
+      std::uint64_t sourceSize;
+      std::int64_t sourceTime;
+      std::uint64_t records;
+      std::uint64_t bytes;
+      // Snapshot::sourceEnd
+      std::uint64_t endOffset;
+      std::uint64_t endLine;
+    };
+
+    const char SNAPSHOT_MAGIC[8] = { 'C', 'S', 'V', 'S', 'N', 'A', 'P', '\0' };
+    const std::uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+  }
+
+  Snapshot::Snapshot(unsigned int texts, unsigned int numbers, unsigned int integers)
+    : _texts(texts), _numbers(numbers), _integers(integers) {}
+
+  Snapshot::~Snapshot(void) {}
+
+  std::string Snapshot::pathFor(const std::string &source)
+  {
+      std::error_code ec;
+      std::filesystem::path directory = std::filesystem::temp_directory_path(ec);
+      if (ec)
+        return std::string();
+
+      // FNV-1a of the full path: files of the same name in other directories
+      std::string full = std::filesystem::absolute(source, ec).lexically_normal().string();
+      std::uint64_t hash = 0xcbf29ce484222325ull;
+      for (auto it = full.begin(); it != full.end(); it++)
+        hash = (hash ^ static_cast<unsigned char>(*it)) * 0x100000001b3ull;
+
+      char suffix[20];
+      std::snprintf(suffix, sizeof(suffix), "-%016llx", static_cast<unsigned long long>(hash));
+      std::string name = std::filesystem::path(source).filename().string();
+      return (directory / "csv-snapshots" / (name + suffix + ".snap")).string();
+  }
+
+  bool Snapshot::load(const std::string &path, const std::string &source)
+  {
+      clear();
+
+      SnapshotHeader header;
+      std::ifstream in(path, std::ios::binary);
+      if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)))
+        return false;
+
+      std::uint64_t size;
+      std::int64_t time;
+      if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0
+          || header.version != VERSION || header.byteOrder != SNAPSHOT_BYTE_ORDER
+          || header.texts != _texts || header.numbers != _numbers
+          || header.integers != _integers
+          || !fileStamp(source, size, time)
+          || header.sourceSize != size || header.sourceTime != time)
+        return false;
+
+      // a damaged header must not size the reads below
+      std::error_code ec;
+      std::uint64_t expected = sizeof(header) + header.bytes
+        + header.records * (_texts * sizeof(std::uint64_t) + _numbers * sizeof(double)
+                            + _integers * sizeof(std::int64_t));
+      if (std::filesystem::file_size(path, ec) != expected || ec)
+        return false;
+
+      _ends.resize(header.records * _texts);
+      _bytes.resize(header.bytes);
+      _values.resize(header.records * _numbers);
+      _integerValues.resize(header.records * _integers);
+      in.read(reinterpret_cast<char *>(_ends.data()), _ends.size() * sizeof(std::uint64_t));
+      in.read(&_bytes[0], _bytes.size());
+      in.read(reinterpret_cast<char *>(_values.data()), _values.size() * sizeof(double));
+      in.read(reinterpret_cast<char *>(_integerValues.data()),
+              _integerValues.size() * sizeof(std::int64_t));
+
+      // truncated, or offsets that do not fit the text block
+      if (!in || (!_ends.empty() && _ends.back() != _bytes.size())
+          || !std::is_sorted(_ends.begin(), _ends.end()))
+      {
+        clear();
+        return false;
+      }
+      _sourceEnd.offset = header.endOffset;
+      _sourceEnd.line = static_cast<unsigned long>(header.endLine);
+      return true;
+  }
+
+  bool Snapshot::save(const std::string &path, const std::string &source,
+                      const Position &end) const
+  {
+      SnapshotHeader header;
+      std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+      header.version = VERSION;
+      header.byteOrder = SNAPSHOT_BYTE_ORDER;
+      header.texts = _texts;
+      header.numbers = _numbers;
+      header.integers = _integers;
+      header.reserved = 0;
+      header.records = size();
+      header.bytes = _bytes.size();
+      header.endOffset = end.offset;
+      header.endLine = end.line;
+      if (path.empty() || !fileStamp(source, header.sourceSize, header.sourceTime))
+        return false;
+
+      std::error_code ec;
+      std::filesystem::path directory = std::filesystem::path(path).parent_path();
+      if (!directory.empty())
+        std::filesystem::create_directories(directory, ec);
+
+      // written aside then renamed, so a reader never sees half a snapshot
+      std::string temporary = path + ".tmp";
+      {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(_ends.data()), _ends.size() * sizeof(std::uint64_t));
+        out.write(_bytes.data(), _bytes.size());
+        out.write(reinterpret_cast<const char *>(_values.data()), _values.size() * sizeof(double));
+        out.write(reinterpret_cast<const char *>(_integerValues.data()),
+                  _integerValues.size() * sizeof(std::int64_t));
+        if (!out.flush())
+        {
+          out.close();
+          std::remove(temporary.c_str());
+          return false;
+        }
+      }
+
+      std::filesystem::rename(temporary, path, ec);
+      if (ec)
+        std::remove(temporary.c_str());
+      return !ec;
+  }
+
+  unsigned int Snapshot::size(void) const
+  {
+      if (_texts != 0)
+        return _ends.size() / _texts;
+      if (_numbers != 0)
+        return _values.size() / _numbers;
+      return _integers != 0 ? _integerValues.size() / _integers : 0;
+  }
+
+  void Snapshot::append(std::initializer_list<std::string_view> texts,
+                        std::initializer_list<double> numbers,
+                        std::initializer_list<std::int64_t> integers)
+  {
+      if (texts.size() != _texts || numbers.size() != _numbers || integers.size() != _integers)
+        throw Error("snapshot record doesn't match its layout");
+
+      for (auto it = texts.begin(); it != texts.end(); it++)
+      {
+        _bytes.append(it->data(), it->size());
+        _ends.push_back(_bytes.size());
+      }
+      _values.insert(_values.end(), numbers.begin(), numbers.end());
+      _integerValues.insert(_integerValues.end(), integers.begin(), integers.end());
+  }
+
+  std::string_view Snapshot::text(unsigned int record, unsigned int field) const
+  {
+      if (record >= size() || field >= _texts)
+        throw Error("can't return this text (doesn't exist)");
+
+      std::size_t index = static_cast<std::size_t>(record) * _texts + field;
+      std::size_t start = index == 0 ? 0 : _ends[index - 1];
+      return std::string_view(_bytes).substr(start, _ends[index] - start);
+  }
+
+  double Snapshot::number(unsigned int record, unsigned int field) const
+  {
+      if (record >= size() || field >= _numbers)
+        throw Error("can't return this number (doesn't exist)");
+      return _values[static_cast<std::size_t>(record) * _numbers + field];
+  }
+
+  std::int64_t Snapshot::integer(unsigned int record, unsigned int field) const
+  {
+      if (record >= size() || field >= _integers)
+        throw Error("can't return this integer (doesn't exist)");
+      return _integerValues[static_cast<std::size_t>(record) * _integers + field];
+  }
+
+  const Position &Snapshot::sourceEnd(void) const
+  {
+      return _sourceEnd;
+  }
+
+  void Snapshot::clear(void)
+  {
+      _bytes.clear();
+      _ends.clear();
+      _values.clear();
+      _integerValues.clear();
+      _sourceEnd = Position();
+  }
+
+  /*
+  ** STRING POOL
+  */
+
+  StringPool::StringPool(void)
+    : _bytes(0)
+  {
+      _texts.push_back(std::string_view());
+      _handles.emplace(std::string_view(), 0);
+  }
+
+  StringPool::Handle StringPool::intern(std::string_view text)
+  {
+      {
+        std::shared_lock<std::shared_mutex> reading(_lock);
+        auto found = _handles.find(text);
+
+        if (found != _handles.end())
+          return found->second;
+      }
+
+      std::unique_lock<std::shared_mutex> writing(_lock);
+      // another thread may have added it in between
+      auto found = _handles.find(text);
+
+      if (found != _handles.end())
+        return found->second;
+      if (_texts.size() > std::numeric_limits<Handle>::max())
+        throw Error("string pool full");
+
+      char *bytes = static_cast<char *>(_storage.allocate(text.size(), 1));
+      std::memcpy(bytes, text.data(), text.size());
+
+      std::string_view stored(bytes, text.size());
+      Handle handle = static_cast<Handle>(_texts.size());
+
+      _texts.push_back(stored);
+      _handles.emplace(stored, handle);
+      _bytes += text.size();
+      return handle;
+  }
+
+  std::string_view StringPool::text(Handle handle) const
+  {
+      std::shared_lock<std::shared_mutex> reading(_lock);
+
+      if (handle >= _texts.size())
+        throw Error("can't return this string (doesn't exist)");
+      return _texts[handle];
+  }
+
+  std::size_t StringPool::size(void) const
+  {
+      std::shared_lock<std::shared_mutex> reading(_lock);
+      return _texts.size();
+  }
+
+  std::size_t StringPool::bytes(void) const
+  {
+      std::shared_lock<std::shared_mutex> reading(_lock);
+      return _bytes;
+  }
+
+  StringPool &StringPool::shared(void)
+  {
+      static StringPool pool;
+      return pool;
+  }
+
+  std::ostream &operator<<(std::ostream &os, const Interned &text)
+  {
+      return os << text.str();
+  }
+
+  /*
+  ** CONVERSIONS
+  */
+
+  // blanks, a '\r' left by a CRLF line end and the quotes of a quoted field
+  static std::string_view trimField(std::string_view text)
+  {
+      const char *strip = " \t\r\"";
+      std::size_t first = text.find_first_not_of(strip);
+
+      if (first == std::string_view::npos)
+        return std::string_view();
+      return text.substr(first, text.find_last_not_of(strip) + 1 - first);
+  }
+
+  template<typename T>
+  static bool fromChars(std::string_view text, T &out)
+  {
+      T value = 0;
+
+      text = trimField(text);
+      if (!text.empty() && text[0] == '+')
+        text.remove_prefix(1);
+      if (!text.empty())
+      {
+        std::from_chars_result res = std::from_chars(text.data(), text.data() + text.size(), value);
+
+        if (res.ec != std::errc() || res.ptr != text.data() + text.size())
+          return false;
+      }
+      out = value;
+      return true;
+  }
+
+  bool toInteger(std::string_view text, long long &out)
+  {
+      return fromChars(text, out);
+  }
+
+  bool toUnsigned(std::string_view text, unsigned long long &out)
+  {
+      return fromChars(text, out);
+  }
+
+  bool toDouble(std::string_view text, double &out)
+  {
+      return fromChars(text, out);
+  }
+
+  bool toCurrency(std::string_view text, double &out)
+  {
+      char digits[64];
+      std::size_t size = 0;
+
+      text = trimField(text);
+      for (auto it = text.begin(); it != text.end(); it++)
+      {
+        if (*it == '$' || *it == ',' || *it == ' ')
+          continue;
+        if (size == sizeof(digits))
+          return false;
+        digits[size++] = *it;
+      }
+      return fromChars(std::string_view(digits, size), out);
+  }
+
+  bool toMoney(std::string_view text, Money &out)
+  {
+      const std::int64_t most = std::numeric_limits<std::int64_t>::max();
+      std::int64_t cents = 0;
+      // digits read after the point, -1 before it
+      int decimals = -1;
+      bool negative = false;
+      bool hasSign = false;
+      bool digits = false;
+
+      text = trimField(text);
+      for (auto it = text.begin(); it != text.end(); it++)
+      {
+        // skipped like toCurrency does
+        if (*it == '$' || *it == ',' || *it == ' ')
+          continue;
+        if ((*it == '-' || *it == '+') && !hasSign && !digits && decimals < 0)
+        {
+          negative = *it == '-';
+          hasSign = true;
+          continue;
+        }
+        if (*it == '.' && decimals < 0)
+        {
+          decimals = 0;
+          continue;
+        }
+        if (*it < '0' || *it > '9')
+          return false;
+        digits = true;
+        // past the cents, only zeros keep the amount exact
+        if (decimals >= 2)
+        {
+          if (*it != '0')
+            return false;
+          continue;
+        }
+        if (decimals >= 0)
+          decimals++;
+        if (cents > (most - (*it - '0')) / 10)
+          return false;
+        cents = cents * 10 + (*it - '0');
+      }
+      if (!digits && (hasSign || decimals >= 0))
+        return false;
+      // in cents: "3" and "3." are 300, "3.5" is 350
+      for (int i = std::max(decimals, 0); i != 2; i++)
+      {
+        if (cents > most / 10)
+          return false;
+        cents *= 10;
+      }
+      out = Money::fromCents(negative ? -cents : cents);
+      return true;
+  }
+
+  bool toPercent(std::string_view text, double &out)
+  {
+      text = trimField(text);
+      if (text.empty() || text.back() != '%')
+        return fromChars(text, out);
+
+      double value;
+      if (!fromChars(text.substr(0, text.size() - 1), value))
+        return false;
+      out = value / 100;
+      return true;
+  }
+
+  template<typename T>
+  static T convertInteger(std::string_view text)
+  {
+      if constexpr (std::numeric_limits<T>::is_signed)
+      {
+        long long value;
+
+        if (toInteger(text, value) && value >= std::numeric_limits<T>::min()
+            && value <= std::numeric_limits<T>::max())
+          return static_cast<T>(value);
+      }
+      else
+      {
+        unsigned long long value;
+
+        if (toUnsigned(text, value) && value <= std::numeric_limits<T>::max())
+          return static_cast<T>(value);
+      }
+      throw Error("can't convert this value");
+  }
+
+  template<typename T, bool (*convert)(std::string_view, double &)>
+  static T convertReal(std::string_view text)
+  {
+      double value;
+
+      if (!convert(text, value))
+        throw Error("can't convert this value");
+      return T{value};
+  }
+
+  template<> int Row::get<int>(unsigned int pos) const
+  {
+      return convertInteger<int>(view(pos));
+  }
+
+  template<> long Row::get<long>(unsigned int pos) const
+  {
+      return convertInteger<long>(view(pos));
+  }
+
+  template<> long long Row::get<long long>(unsigned int pos) const
+  {
+      return convertInteger<long long>(view(pos));
+  }
+
+  template<> unsigned int Row::get<unsigned int>(unsigned int pos) const
+  {
+      return convertInteger<unsigned int>(view(pos));
+  }
+
+  template<> unsigned long Row::get<unsigned long>(unsigned int pos) const
+  {
+      return convertInteger<unsigned long>(view(pos));
+  }
+
+  template<> unsigned long long Row::get<unsigned long long>(unsigned int pos) const
+  {
+      return convertInteger<unsigned long long>(view(pos));
+  }
+
+  template<> float Row::get<float>(unsigned int pos) const
+  {
+      return static_cast<float>(convertReal<double, toDouble>(view(pos)));
+  }
+
+  template<> double Row::get<double>(unsigned int pos) const
+  {
+      return convertReal<double, toDouble>(view(pos));
+  }
+
+  template<> std::string Row::get<std::string>(unsigned int pos) const
+  {
+      return std::string(view(pos));
+  }
+
+  template<> std::string_view Row::get<std::string_view>(unsigned int pos) const
+  {
+      return view(pos);
+  }
+
+  template<> Currency Row::get<Currency>(unsigned int pos) const
+  {
+      return convertReal<Currency, toCurrency>(view(pos));
+  }
+
+  template<> Percent Row::get<Percent>(unsigned int pos) const
+  {
+      return convertReal<Percent, toPercent>(view(pos));
+  }
+
+  template<> Money Row::get<Money>(unsigned int pos) const
+  {
+      Money value;
+
+      if (!toMoney(view(pos), value))
+        throw Error("can't convert this value");
+      return value;
+  }
+
+  /*
+  ** MONEY
+  */
+
+  // the kernels load arrays of amounts as arrays of 64-bit integers
+  static_assert(sizeof(Money) == sizeof(std::int64_t), "Money must be its cents only");
+
+  std::string Money::str(void) const
+  {
+      // the magnitude, which -INT64_MIN would overflow as a signed value
+      std::uint64_t magnitude = _cents < 0 ? 0 - static_cast<std::uint64_t>(_cents) : _cents;
+      std::string whole = std::to_string(magnitude / 100);
+      std::string text = _cents < 0 ? "-$" : "$";
+
+      for (std::size_t i = 0; i != whole.size(); i++)
+      {
+        if (i != 0 && (whole.size() - i) % 3 == 0)
+          text += ',';
+        text += whole[i];
+      }
+      text += '.';
+      text += static_cast<char>('0' + magnitude % 100 / 10);
+      text += static_cast<char>('0' + magnitude % 10);
+      return text;
+  }
+
+  std::ostream &operator<<(std::ostream &os, Money amount)
+  {
+      return os << amount.str();
+  }
+
+  typedef std::int64_t (*MoneyFold)(const Money *, std::size_t);
+
+  static std::int64_t sumScalar(const Money *amounts, std::size_t count)
+  {
+      // independent partial sums, as in ColumnTable::sum
+      std::int64_t partial[4] = { 0, 0, 0, 0 };
+      std::size_t i = 0;
+
+      for (; i + 4 <= count; i += 4)
+      {
+        partial[0] += amounts[i].cents();
+        partial[1] += amounts[i + 1].cents();
+        partial[2] += amounts[i + 2].cents();
+        partial[3] += amounts[i + 3].cents();
+      }
+      for (; i != count; i++)
+        partial[0] += amounts[i].cents();
+      return (partial[0] + partial[1]) + (partial[2] + partial[3]);
+  }
+
+  template<bool Max>
+  static std::int64_t extremeScalar(const Money *amounts, std::size_t count)
+  {
+      std::int64_t best = count != 0 ? amounts[0].cents() : 0;
+
+      for (std::size_t i = 1; i < count; i++)
+        best = Max ? std::max(best, amounts[i].cents()) : std::min(best, amounts[i].cents());
+      return best;
+  }
+
+#if CSV_X86
+  static std::int64_t sumSse2(const Money *amounts, std::size_t count)
+  {
+      const __m128i *p = reinterpret_cast<const __m128i *>(amounts);
+      __m128i a = _mm_setzero_si128();
+      __m128i b = _mm_setzero_si128();
+      std::size_t i = 0;
+
+      // two accumulators of two lanes each
+      for (; i + 4 <= count; i += 4, p += 2)
+      {
+        a = _mm_add_epi64(a, _mm_loadu_si128(p));
+        b = _mm_add_epi64(b, _mm_loadu_si128(p + 1));
+      }
+
+      std::int64_t lanes[2];
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), _mm_add_epi64(a, b));
+      return lanes[0] + lanes[1] + sumScalar(amounts + i, count - i);
+  }
+
+  CSV_TARGET_AVX2 static std::int64_t sumAvx2(const Money *amounts, std::size_t count)
+  {
+      const __m256i *p = reinterpret_cast<const __m256i *>(amounts);
+      __m256i a = _mm256_setzero_si256();
+      __m256i b = _mm256_setzero_si256();
+      std::size_t i = 0;
+
+      // two accumulators of four lanes each
+      for (; i + 8 <= count; i += 8, p += 2)
+      {
+        a = _mm256_add_epi64(a, _mm256_loadu_si256(p));
+        b = _mm256_add_epi64(b, _mm256_loadu_si256(p + 1));
+      }
+
+      std::int64_t lanes[4];
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), _mm256_add_epi64(a, b));
+      return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + sumScalar(amounts + i, count - i);
+  }
+
+  // SSE2 has no 64-bit compare: min and max only go wide with AVX2
+  template<bool Max>
+  CSV_TARGET_AVX2 static std::int64_t extremeAvx2(const Money *amounts, std::size_t count)
+  {
+      if (count < 4)
+        return extremeScalar<Max>(amounts, count);
+
+      const __m256i *p = reinterpret_cast<const __m256i *>(amounts);
+      __m256i best = _mm256_loadu_si256(p);
+      std::size_t i = 4;
+
+      for (p++; i + 4 <= count; i += 4, p++)
+      {
+        __m256i v = _mm256_loadu_si256(p);
+        __m256i better = Max ? _mm256_cmpgt_epi64(v, best) : _mm256_cmpgt_epi64(best, v);
+
+        best = _mm256_blendv_epi8(best, v, better);
+      }
+
+      std::int64_t lanes[4];
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), best);
+      std::int64_t result = lanes[0];
+      for (unsigned int lane = 1; lane != 4; lane++)
+        result = Max ? std::max(result, lanes[lane]) : std::min(result, lanes[lane]);
+      for (; i != count; i++)
+        result = Max ? std::max(result, amounts[i].cents()) : std::min(result, amounts[i].cents());
+      return result;
+  }
+#endif
+
+  Money sumMoney(const Money *amounts, std::size_t count)
+  {
+#if CSV_X86
+      static const MoneyFold fn = hasAvx2() ? sumAvx2 : sumSse2;
+#else
+      static const MoneyFold fn = sumScalar;
+#endif
+      return Money::fromCents(fn(amounts, count));
+  }
+
+  Money minMoney(const Money *amounts, std::size_t count)
+  {
+#if CSV_X86
+      static const MoneyFold fn = hasAvx2() ? extremeAvx2<false> : extremeScalar<false>;
+#else
+      static const MoneyFold fn = extremeScalar<false>;
+#endif
+      return Money::fromCents(fn(amounts, count));
+  }
+
+  Money maxMoney(const Money *amounts, std::size_t count)
+  {
+#if CSV_X86
+      static const MoneyFold fn = hasAvx2() ? extremeAvx2<true> : extremeScalar<true>;
+#else
+      static const MoneyFold fn = extremeScalar<true>;
+#endif
+      return Money::fromCents(fn(amounts, count));
+  }
+
+  std::vector<std::uint64_t> histogramMoney(const Money *amounts, std::size_t count,
+                                            Money low, Money width, unsigned int bins)
+  {
+      if (bins == 0 || width.cents() <= 0)
+        throw Error("can't make a histogram without bins");
+
+      // no SIMD scatter to count with: instead four sets of counters, taken
+      // in turn, so that a run of amounts in one bin is not one long chain
+      // of increments to the same counter
+      std::vector<std::uint64_t> counts(4 * static_cast<std::size_t>(bins), 0);
+      const std::uint64_t last = bins - 1;
+      auto binOf = [&](Money amount) -> std::uint64_t
+      {
+        if (amount < low)
+          return 0;
+        // the distance from low, which always fits unsigned
+        std::uint64_t offset = static_cast<std::uint64_t>(amount.cents())
+                               - static_cast<std::uint64_t>(low.cents());
+        return std::min<std::uint64_t>(offset / width.cents(), last);
+      };
+      std::size_t i = 0;
+
+      for (; i + 4 <= count; i += 4)
+      {
+        counts[binOf(amounts[i])]++;
+        counts[bins + binOf(amounts[i + 1])]++;
+        counts[2 * bins + binOf(amounts[i + 2])]++;
+        counts[3 * bins + binOf(amounts[i + 3])]++;
+      }
+      for (; i != count; i++)
+        counts[binOf(amounts[i])]++;
+
+      for (unsigned int bin = 0; bin != bins; bin++)
+        counts[bin] += counts[bins + bin] + counts[2 * bins + bin] + counts[3 * bins + bin];
+      counts.resize(bins);
+      return counts;
+  }
+
+  /*
+  ** SCHEMA
+  */
+
+  Schema::Schema(const std::vector<std::string> &names)
+      : _names(names), _slots(names.size())
+  {
+    _index.reserve(_names.size());
+    _columns.reserve(_names.size());
+    // on duplicate names the first column wins, as with a linear search
+    for (unsigned int i = 0; i != _names.size(); i++)
+    {
+      _index.emplace(_names[i], i);
+      _columns.push_back(i);
+      _slots[i] = i;
+    }
+  }
+
+  Schema::Schema(const std::vector<std::string> &names, const std::vector<unsigned int> &columns)
+      : Schema(names)
+  {
+    std::vector<bool> loaded(_names.size(), false);
+
+    for (auto it = columns.begin(); it != columns.end(); it++)
+    {
+      if (*it >= _names.size())
+        throw Error("can't load this column (doesn't exist)");
+      loaded[*it] = true;
+    }
+    _columns.clear();
+    for (unsigned int i = 0; i != _names.size(); i++)
+    {
+      _slots[i] = loaded[i] ? static_cast<int>(_columns.size()) : -1;
+      if (loaded[i])
+        _columns.push_back(i);
+    }
+  }
+
+  const std::vector<unsigned int> &Schema::columns(void) const
+  {
+    return _columns;
+  }
+
+  int Schema::slotOf(unsigned int column) const
+  {
+    return column < _slots.size() ? _slots[column] : -1;
+  }
+
+  unsigned int Schema::size(void) const
+  {
+    return _names.size();
+  }
+
+  const std::vector<std::string> &Schema::names(void) const
+  {
+    return _names;
+  }
+
+  int Schema::indexOf(const std::string &name) const
+  {
+    auto it = _index.find(name);
+
+    return it == _index.end() ? -1 : static_cast<int>(it->second);
+  }
+
+  /*
+  ** ROW
+  */
+
+  Row::Row(const Schema &schema, std::pmr::memory_resource *memory)
+      : _schema(&schema), _values(memory), _views(memory) {}
+
+  Row::~Row(void) {}
+
+  unsigned int Row::size(void) const
+  {
+    return _views.empty() ? _values.size() : _views.size();
+  }
+
+  void Row::reserve(unsigned int fields)
+  {
+    _views.reserve(fields);
+  }
+
+  void Row::push(std::string_view value)
+  {
+    if (!_views.empty())
+      materialize();
+    _values.emplace_back(value);
+  }
+
+  void Row::pushView(std::string_view value)
+  {
+    _views.push_back(value);
+  }
+
+  void Row::clear(void)
+  {
+    _values.clear();
+    _views.clear();
+  }
+
+  const Schema &Row::getSchema(void) const
+  {
+    return *_schema;
+  }
+
+  /*
+  ** Copy the mapped fields into owned strings, so the row can be modified.
+  */
+  void Row::materialize(void)
+  {
+    if (_views.empty())
+      return;
+    _values.assign(_views.begin(), _views.end());
+    _views.clear();
+  }
+
+  std::string_view Row::field(unsigned int slot) const
+  {
+    return _views.empty() ? std::string_view(_values[slot]) : _views[slot];
+  }
+
+  std::string_view Row::view(unsigned int valuePosition) const
+  {
+    int slot = _schema->slotOf(valuePosition);
+
+    if (slot >= 0 && static_cast<unsigned int>(slot) < size())
+      return field(slot);
+    throw Error("can't return this value (doesn't exist)");
+  }
+
+  bool Row::set(const std::string &key, const std::string &value) 
+  {
+    int pos = _schema->indexOf(key);
+    int slot = pos < 0 ? -1 : _schema->slotOf(pos);
+
+    if (slot < 0 || static_cast<unsigned int>(slot) >= size())
+      return false;
+    if (!_views.empty())
+      materialize();
+    _values[slot] = value;
+    return true;
+  }
+
+  const std::string Row::operator[](unsigned int valuePosition) const
+  {
+       return std::string(view(valuePosition));
+  }
+
+  const std::string Row::operator[](const std::string &key) const
+  {
+      int pos = _schema->indexOf(key);
+
+      if (pos < 0)
+        throw Error("can't return this value (doesn't exist)");
+      return std::string(view(pos));
+  }
+
+  std::ostream &operator<<(std::ostream &os, const Row &row)
+  {
+      for (unsigned int i = 0; i != row.size(); i++)
+          os << row.field(i) << " | ";
+
+      return os;
+  }
+
+  std::ofstream &operator<<(std::ofstream &os, const Row &row)
+  {
+    for (unsigned int i = 0; i != row.size(); i++)
+    {
+        os << row.field(i);
+        if (i < row.size() - 1)
+          os << ",";
+    }
+    return os;
+  }
+
+  /*
+  ** ROW STORE
+  */
+
+  RowStore::RowStore(void)
+    : _root(NIL), _seed(2463534242u), _generation(0), _ordered(true) {}
+
+  unsigned int RowStore::size(void) const
+  {
+    return sizeOf(_root);
+  }
+
+  unsigned int RowStore::sizeOf(unsigned int node) const
+  {
+    return node == NIL ? 0 : _nodes[node].size;
+  }
+
+  void RowStore::update(unsigned int node)
+  {
+    Node &n = _nodes[node];
+
+    n.size = 1 + sizeOf(n.left) + sizeOf(n.right);
+    if (n.left != NIL)
+      _nodes[n.left].parent = node;
+    if (n.right != NIL)
+      _nodes[n.right].parent = node;
+  }
+
+  unsigned int RowStore::allocate(Row *row)
+  {
+    // xorshift: the treap only needs its priorities spread out
+    _seed ^= _seed << 13;
+    _seed ^= _seed >> 17;
+    _seed ^= _seed << 5;
+
+    Node node = { row, NIL, NIL, NIL, 1, _seed, _generation };
+    if (_free.empty())
+    {
+      _nodes.push_back(node);
+      return _nodes.size() - 1;
+    }
+    unsigned int slot = _free.back();
+    _free.pop_back();
+    _nodes[slot] = node;
+    return slot;
+  }
+
+  /*
+  ** Cut the treap `node` into its first `count` rows and the others.
+  */
+  void RowStore::split(unsigned int node, unsigned int count, unsigned int &first, unsigned int &rest)
+  {
+    if (node == NIL)
+    {
+      first = rest = NIL;
+      return;
+    }
+
+    unsigned int left = sizeOf(_nodes[node].left);
+    if (left < count)
+    {
+      split(_nodes[node].right, count - left - 1, _nodes[node].right, rest);
+      first = node;
+    }
+    else
+    {
+      split(_nodes[node].left, count, first, _nodes[node].left);
+      rest = node;
+    }
+    update(node);
+  }
+
+  unsigned int RowStore::merge(unsigned int first, unsigned int rest)
+  {
+    if (first == NIL)
+      return rest;
+    if (rest == NIL)
+      return first;
+
+    if (_nodes[first].priority > _nodes[rest].priority)
+    {
+      _nodes[first].right = merge(_nodes[first].right, rest);
+      update(first);
+      return first;
+    }
+    _nodes[rest].left = merge(first, _nodes[rest].left);
+    update(rest);
+    return rest;
+  }
+
+  void RowStore::fix(unsigned int node)
+  {
+    if (node == NIL)
+      return;
+    fix(_nodes[node].left);
+    fix(_nodes[node].right);
+    update(node);
+  }
+
+  /*
+  ** Replace the content with `rows` in O(n): the treap is built as the
+  ** Cartesian tree of the rows' priorities, with a stack of its right spine.
+  */
+  void RowStore::assign(const std::vector<Row *> &rows)
+  {
+    clear();
+    _nodes.reserve(rows.size());
+
+    std::vector<unsigned int> spine;
+    for (auto it = rows.begin(); it != rows.end(); it++)
+    {
+      unsigned int node = allocate(*it);
+      unsigned int last = NIL;
+
+      while (!spine.empty() && _nodes[spine.back()].priority < _nodes[node].priority)
+      {
+        last = spine.back();
+        spine.pop_back();
+      }
+      _nodes[node].left = last;
+      if (!spine.empty())
+        _nodes[spine.back()].right = node;
+      spine.push_back(node);
+    }
+    if (!spine.empty())
+    {
+      _root = spine.front();
+      fix(_root);
+      _nodes[_root].parent = NIL;
+    }
+    _order = rows;
+  }
+
+  RowStore::Handle RowStore::insert(unsigned int pos, Row *row)
+  {
+    unsigned int node = allocate(row);
+    unsigned int first, rest;
+
+    if (_ordered && pos == size())
+      _order.push_back(row);
+    else
+      _ordered = false;
+
+    split(_root, pos, first, rest);
+    _root = merge(merge(first, node), rest);
+    _nodes[_root].parent = NIL;
+    return handleOf(node);
+  }
+
+  Row *RowStore::erase(unsigned int pos)
+  {
+    unsigned int first, node, rest;
+
+    if (_ordered && pos + 1 == size())
+      _order.pop_back();
+    else
+      _ordered = false;
+
+    split(_root, pos, first, rest);
+    split(rest, 1, node, rest);
+    _root = merge(first, rest);
+    if (_root != NIL)
+      _nodes[_root].parent = NIL;
+
+    Row *row = _nodes[node].row;
+    _nodes[node].row = nullptr;
+    _free.push_back(node);
+    // the row that reuses the slot gets a handle of its own
+    _generation++;
+    return row;
+  }
+
+  void RowStore::clear(void)
+  {
+    _nodes.clear();
+    _free.clear();
+    _order.clear();
+    _root = NIL;
+    _ordered = true;
+    _generation++;
+  }
+
+  unsigned int RowStore::find(unsigned int pos) const
+  {
+    unsigned int node = _root;
+
+    for (;;)
+    {
+      unsigned int left = sizeOf(_nodes[node].left);
+
+      if (pos == left)
+        return node;
+      if (pos < left)
+        node = _nodes[node].left;
+      else
+      {
+        pos -= left + 1;
+        node = _nodes[node].right;
+      }
+    }
+  }
+
+  Row *RowStore::at(unsigned int pos) const
+  {
+    return _ordered ? _order[pos] : _nodes[find(pos)].row;
+  }
+
+  RowStore::Handle RowStore::handleOf(unsigned int node) const
+  {
+    return static_cast<Handle>(_nodes[node].generation) << 32 | node;
+  }
+
+  RowStore::Handle RowStore::handleAt(unsigned int pos) const
+  {
+    return handleOf(find(pos));
+  }
+
+  int RowStore::positionOf(Handle handle) const
+  {
+    unsigned int slot = static_cast<unsigned int>(handle);
+
+    if (slot >= _nodes.size() || _nodes[slot].row == nullptr
+        || _nodes[slot].generation != static_cast<std::uint32_t>(handle >> 32))
+      return -1;
+
+    unsigned int pos = sizeOf(_nodes[slot].left);
+    for (unsigned int node = slot; _nodes[node].parent != NIL; node = _nodes[node].parent)
+    {
+      unsigned int parent = _nodes[node].parent;
+      if (_nodes[parent].right == node)
+        pos += sizeOf(_nodes[parent].left) + 1;
+    }
+    return pos;
+  }
+
+  /*
+  ** MAPPED FILE
+  */
+
+  MappedFile::MappedFile(void)
+    : _data(nullptr), _size(0)
+#ifdef _WIN32
+    , _fileHandle(INVALID_HANDLE_VALUE), _mapHandle(nullptr)
+#endif
+  {
+  }
+
+  MappedFile::~MappedFile(void)
+  {
+    close();
+  }
+
+  bool MappedFile::open(const std::string &path)
+  {
+    close();
+#ifdef _WIN32
+    _fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (_fileHandle == INVALID_HANDLE_VALUE)
+      return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_fileHandle, &size))
+    {
+      close();
+      return false;
+    }
+    _size = static_cast<std::size_t>(size.QuadPart);
+    if (_size == 0)
+      return true;
+
+    _mapHandle = CreateFileMappingA(_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapHandle == nullptr)
+    {
+      close();
+      return false;
+    }
+    _data = static_cast<const char *>(MapViewOfFile(_mapHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+      ::close(fd);
+      return false;
+    }
+    _size = static_cast<std::size_t>(st.st_size);
+    if (_size == 0)
+    {
+      ::close(fd);
+      return true;
+    }
+
+    void *addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr != MAP_FAILED)
+    {
+      madvise(addr, _size, MADV_SEQUENTIAL);
+      _data = static_cast<const char *>(addr);
+    }
+#endif
+    if (_data == nullptr)
+    {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void MappedFile::close(void)
+  {
+#ifdef _WIN32
+    if (_data != nullptr)
+      UnmapViewOfFile(_data);
+    if (_mapHandle != nullptr)
+      CloseHandle(_mapHandle);
+    if (_fileHandle != INVALID_HANDLE_VALUE)
+      CloseHandle(_fileHandle);
+    _mapHandle = nullptr;
+    _fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (_data != nullptr)
+      munmap(const_cast<char *>(_data), _size);
+#endif
+    _data = nullptr;
+    _size = 0;
+  }
+
+  const char *MappedFile::data(void) const
+  {
+    return _data;
+  }
+
+  std::size_t MappedFile::size(void) const
+  {
+    return _size;
   }
 }
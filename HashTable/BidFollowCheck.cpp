@@ -0,0 +1,140 @@
+//============================================================================
+// Name        : BidFollowCheck.cpp
+// Author      : David Towne
+// Version     : 1.0
+// Copyright   : Copyright © 2017 SNHU COCE
+// Description : Checks that following a loaded file only adds new bids
+//============================================================================
+//
+// Not part of the HashTable program. Build and run it from this directory,
+// with eBid_Monthly_Sales_Dec_2016.csv next to it:
+//
+//   g++ -std=c++17 -O2 -pthread CSVparser.cpp Bid.cpp BidFollowCheck.cpp -o BidFollowCheck
+//   ./BidFollowCheck
+//
+// It exits with 1 after listing what went wrong, and with 0 otherwise.
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Bid.hpp"
+
+using namespace std;
+
+static unsigned long failures = 0;
+
+static void expect(const string& what, unsigned long actual, unsigned long expected) {
+    if (actual != expected) {
+        cerr << "FAIL: " << what << ": " << actual << " instead of " << expected << endl;
+        failures++;
+    }
+}
+
+static string readFile(const string& path) {
+    ifstream in(path, ios::binary);
+    return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+static void writeFile(const string& path, const string& data, ios::openmode mode) {
+    ofstream out(path, ios::binary | mode);
+    out << data;
+}
+
+/**
+ * Follow a file from where a load stopped, as the programs do
+ *
+ * @return the number of bids the first poll adds
+ */
+static unsigned long followFrom(const string& path, const csv::Position& loaded,
+        csv::Follower*& follower, unsigned long& count) {
+    BidSink add = [&count](Bid&&) { count++; };
+    csv::Options options;
+    options.lenient = true;
+    delete follower;
+    follower = new csv::Follower(path, ',', options);
+    follower->resume(loaded);
+    return followBids(follower, add);
+}
+
+/**
+ * The one and only main() method
+ */
+int main() {
+    string source = readFile("eBid_Monthly_Sales_Dec_2016.csv");
+    if (source.empty()) {
+        cerr << "FAIL: eBid_Monthly_Sales_Dec_2016.csv not found" << endl;
+        return 1;
+    }
+    // two of its bids, appended later on
+    istringstream lines(source);
+    string header, first, second;
+    getline(lines, header);
+    getline(lines, first);
+    getline(lines, second);
+
+    filesystem::path directory = filesystem::temp_directory_path() / "BidFollowCheck";
+    filesystem::create_directories(directory);
+    string path = (directory / "bids.csv").string();
+    string other = (directory / "other.csv").string();
+    writeFile(path, source, ios::trunc);
+
+    csv::Follower* follower = nullptr;
+    unsigned long count = 0;
+    BidSink add = [&count](Bid&&) { count++; };
+
+    // load, then follow: nothing new yet
+    csv::Position loaded = loadBids(path, add);
+    expect("bids loaded", count, 76);
+    expect("bids followed right after a load", followFrom(path, loaded, follower, count), 0);
+    expect("bids after load then follow", count, 76);
+
+    // only the rows appended since are added
+    writeFile(path, first + "\n" + second + "\n", ios::app);
+    expect("bids appended", followBids(follower, add), 2);
+    expect("bids after two appended", count, 78);
+
+    // the same from a snapshot: a second load of the file now unchanged
+    count = 0;
+    loadBids(path, add);
+    count = 0;
+    loaded = loadBids(path, add);
+    expect("bids loaded from the snapshot", count, 78);
+    expect("bids followed after a snapshot load", followFrom(path, loaded, follower, count), 0);
+    writeFile(path, first + "\n", ios::app);
+    expect("bid appended after a snapshot load", followBids(follower, add), 1);
+
+    // following without a load reads every bid
+    count = 0;
+    expect("bids followed without a load", followFrom(path, csv::Position(), follower, count), 79);
+
+    // several files: following goes on from the end of the last one
+    writeFile(other, header + "\n", ios::trunc);
+    count = 0;
+    loaded = loadAllBids({ other, path }, add);
+    expect("bids followed after loading several files", followFrom(path, loaded, follower, count), 0);
+
+    // a file replaced by a shorter one after the load is read again whole
+    count = 0;
+    loaded = loadBids(path, add);
+    writeFile(path, header + "\n" + first + "\n", ios::trunc);
+    count = 0;
+    expect("bids of a file replaced after the load", followFrom(path, loaded, follower, count), 1);
+
+    delete follower;
+    for (const string& file : { path, other }) {
+        remove(csv::Snapshot::pathFor(file).c_str());
+    }
+    filesystem::remove_all(directory);
+
+    if (failures > 0) {
+        cerr << failures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "Following a loaded file only adds the bids appended to it" << endl;
+    return 0;
+}
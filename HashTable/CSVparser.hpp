@@ -1,8 +1,23 @@
 #ifndef     _CSVPARSER_HPP_
 # define    _CSVPARSER_HPP_
 
+# include <algorithm>
+# include <atomic>
+# include <cstddef>
+# include <cstdint>
+# include <exception>
+# include <fstream>
+# include <initializer_list>
+# include <limits>
+# include <memory>
+# include <memory_resource>
+# include <shared_mutex>
 # include <stdexcept>
 # include <string>
+# include <string_view>
+# include <thread>
+# include <type_traits>
+# include <unordered_map>
 # include <vector>
 # include <list>
 # include <sstream>
@@ -19,35 +34,173 @@ namespace csv
         }
     };
 
+    /*
+    ** Column names of a file and a name -> position index, built once by
+    ** the parser and shared (read-only) by all of its rows. A schema can be
+    ** projected on some of the columns: rows then only hold those, but are
+    ** still indexed by the column positions of the file.
+    */
+    class Schema
+    {
+      public:
+        Schema(const std::vector<std::string> &);
+        Schema(const std::vector<std::string> &, const std::vector<unsigned int> &columns);
+
+      public:
+        unsigned int size(void) const;
+        const std::vector<std::string> &names(void) const;
+        int indexOf(const std::string &) const;
+        const std::vector<unsigned int> &columns(void) const;
+        int slotOf(unsigned int column) const;
+
+      private:
+        const std::vector<std::string> _names;
+        std::unordered_map<std::string, unsigned int> _index;
+        // loaded columns, and the position of each column among them (-1 if not loaded)
+        std::vector<unsigned int> _columns;
+        std::vector<int> _slots;
+    };
+
+    /*
+    ** Allocation-free conversions of a field text, built on std::from_chars.
+    ** Blanks and the double quotes around a quoted field are ignored and an
+    ** empty field reads as 0; anything else that is not a number makes the
+    ** conversion return false, leaving `out` untouched.
+    */
+    bool toInteger(std::string_view, long long &out);
+    bool toUnsigned(std::string_view, unsigned long long &out);
+    bool toDouble(std::string_view, double &out);
+    // money such as "$3,000.50 ": '$' and thousands separators are skipped
+    bool toCurrency(std::string_view, double &out);
+    // "23%" as well as "0.23" both read as 0.23
+    bool toPercent(std::string_view, double &out);
+
+    /*
+    ** Column types for Row::get, for money and percentage columns.
+    */
+    struct Currency
+    {
+        double value;
+        operator double(void) const { return value; }
+    };
+
+    struct Percent
+    {
+        double value;
+        operator double(void) const { return value; }
+    };
+
+    /*
+    ** An amount of money held exactly, as a whole number of cents: a sum of
+    ** any length has none of the rounding drift of a sum of doubles. Read
+    ** by toMoney and written the way the files write it, "$3,000.50".
+    */
+    class Money
+    {
+
+    public:
+        Money(void) : _cents(0) {}
+        static Money fromCents(std::int64_t cents) { Money money; money._cents = cents; return money; }
+
+    public:
+        std::int64_t cents(void) const { return _cents; }
+        double toDouble(void) const { return _cents / 100.0; }
+        std::string str(void) const;
+
+        Money &operator+=(Money other) { _cents += other._cents; return *this; }
+        Money &operator-=(Money other) { _cents -= other._cents; return *this; }
+        Money operator+(Money other) const { return fromCents(_cents + other._cents); }
+        Money operator-(Money other) const { return fromCents(_cents - other._cents); }
+        Money operator-(void) const { return fromCents(-_cents); }
+        bool operator==(Money other) const { return _cents == other._cents; }
+        bool operator!=(Money other) const { return _cents != other._cents; }
+        bool operator<(Money other) const { return _cents < other._cents; }
+        bool operator<=(Money other) const { return _cents <= other._cents; }
+        bool operator>(Money other) const { return _cents > other._cents; }
+        bool operator>=(Money other) const { return _cents >= other._cents; }
+
+    private:
+        std::int64_t _cents;
+    };
+
+    std::ostream &operator<<(std::ostream &, Money);
+
+    // exact money such as "$3,000.50 " or "-$2.5": like toCurrency, but
+    // digits past the cents must be zeros
+    bool toMoney(std::string_view, Money &out);
+
+    /*
+    ** Aggregates over a contiguous array of amounts, exact, run 4 amounts
+    ** at a time with AVX2 or 2 with SSE2 when the CPU has them. The min and
+    ** max of no amounts are 0.
+    */
+    Money sumMoney(const Money *, std::size_t count);
+    Money minMoney(const Money *, std::size_t count);
+    Money maxMoney(const Money *, std::size_t count);
+    // how many amounts fall in each of `bins` bins of `width` from `low`;
+    // the first and last bins also count the amounts below and above
+    std::vector<std::uint64_t> histogramMoney(const Money *, std::size_t count,
+                                              Money low, Money width, unsigned int bins);
+
     class Row
     {
     	public:
-    	    Row(const std::vector<std::string> &);
+    	    // the schema is not copied and must outlive the row, as must
+    	    // `memory`, which holds the row's field storage
+    	    Row(const Schema &, std::pmr::memory_resource *memory = std::pmr::get_default_resource());
     	    ~Row(void);
 
     	public:
             unsigned int size(void) const;
-            void push(const std::string &);
-            bool set(const std::string &, const std::string &); 
+            void reserve(unsigned int);
+            void push(std::string_view);
+            void pushView(std::string_view);
+            bool set(const std::string &, const std::string &);
+            std::string_view view(unsigned int) const;
+            void materialize(void);
+            void clear(void);
+            const Schema &getSchema(void) const;
 
     	private:
-    		const std::vector<std::string> _header;
-    		std::vector<std::string> _values;
+    		const Schema *_schema;
+    		// loaded fields, in the order of Schema::columns()
+    		std::pmr::vector<std::pmr::string> _values;
+    		// fields held elsewhere: in the parser's mapping or arena
+    		std::pmr::vector<std::string_view> _views;
+
+    		std::string_view field(unsigned int slot) const;
 
         public:
 
+            /*
+            ** Field converted to T. Numbers, strings, Currency, Percent and Money
+            ** are specialized (see below); other types go through a
+            ** stringstream. Throws if the field is not a valid T.
+            */
+            template<typename T>
+            T get(unsigned int pos) const
+            {
+                T res;
+                std::stringstream ss;
+                ss << view(pos);
+                ss >> res;
+                return res;
+            }
+
+            template<typename T>
+            T get(const std::string &valueName) const
+            {
+                int pos = _schema->indexOf(valueName);
+
+                if (pos < 0)
+                    throw Error("can't return this value (doesn't exist)");
+                return get<T>(pos);
+            }
+
             template<typename T>
             const T getValue(unsigned int pos) const
             {
-                if (pos < _values.size())
-                {
-                    T res;
-                    std::stringstream ss;
-                    ss << _values[pos];
-                    ss >> res;
-                    return res;
-                }
-                throw Error("can't return this value (doesn't exist)");
+                return get<T>(pos);
             }
             const std::string operator[](unsigned int) const;
             const std::string operator[](const std::string &valueName) const;
@@ -55,23 +208,349 @@ namespace csv
             friend std::ofstream& operator<<(std::ofstream& os, const Row &row);
     };
 
+    template<> int Row::get<int>(unsigned int) const;
+    template<> long Row::get<long>(unsigned int) const;
+    template<> long long Row::get<long long>(unsigned int) const;
+    template<> unsigned int Row::get<unsigned int>(unsigned int) const;
+    template<> unsigned long Row::get<unsigned long>(unsigned int) const;
+    template<> unsigned long long Row::get<unsigned long long>(unsigned int) const;
+    template<> float Row::get<float>(unsigned int) const;
+    template<> double Row::get<double>(unsigned int) const;
+    template<> std::string Row::get<std::string>(unsigned int) const;
+    template<> std::string_view Row::get<std::string_view>(unsigned int) const;
+    template<> Currency Row::get<Currency>(unsigned int) const;
+    template<> Percent Row::get<Percent>(unsigned int) const;
+    template<> Money Row::get<Money>(unsigned int) const;
+
+    /*
+    ** Store a field's text into `out` the way Row::get<As> converts it,
+    ** straight from the record: no Row, no std::string for a number. False
+    ** (and `out` left alone) if the text is not a valid As.
+    */
+    template<typename As, typename V>
+    bool decodeField(std::string_view text, V &out)
+    {
+        if constexpr (std::is_same<As, std::string>::value)
+        {
+            out.assign(text.data(), text.size());
+            return true;
+        }
+        else if constexpr (std::is_same<As, Currency>::value || std::is_same<As, Percent>::value
+                           || std::is_floating_point<As>::value)
+        {
+            double value;
+            bool ok = std::is_same<As, Currency>::value ? toCurrency(text, value)
+                      : std::is_same<As, Percent>::value ? toPercent(text, value)
+                      : toDouble(text, value);
+
+            if (ok)
+                out = static_cast<V>(value);
+            return ok;
+        }
+        else if constexpr (std::is_same<As, Money>::value)
+        {
+            Money value;
+
+            if (!toMoney(text, value))
+                return false;
+            out = value;
+            return true;
+        }
+        else if constexpr (std::is_integral<As>::value && !std::is_same<As, bool>::value)
+        {
+            if constexpr (std::is_signed<As>::value)
+            {
+                long long value;
+
+                if (!toInteger(text, value) || value < std::numeric_limits<As>::min()
+                    || value > std::numeric_limits<As>::max())
+                    return false;
+                out = static_cast<V>(value);
+            }
+            else
+            {
+                unsigned long long value;
+
+                if (!toUnsigned(text, value) || value > std::numeric_limits<As>::max())
+                    return false;
+                out = static_cast<V>(value);
+            }
+            return true;
+        }
+        else if constexpr (std::is_constructible<As, std::string_view>::value)
+        {
+            // Interned and other types built from the text itself
+            out = As(text);
+            return true;
+        }
+        else
+        {
+            std::stringstream ss;
+            As value;
+
+            ss << text;
+            if (!(ss >> value))
+                return false;
+            out = value;
+            return true;
+        }
+    }
+
+    /*
+    ** Member `M` of a struct bound to column `C` of a file (by position),
+    ** decoded as `As`: the member's own type unless given, e.g. Currency
+    ** for a double holding money.
+    */
+    template<auto M, unsigned int C, typename As = void>
+    struct Field;
+
+    template<typename T, typename V, V T::*M, unsigned int C, typename As>
+    struct Field<M, C, As>
+    {
+        typedef T Type;
+        typedef typename std::conditional<std::is_void<As>::value, V, As>::type Decoded;
+        static const unsigned int column = C;
+
+        static_assert(std::is_same<Decoded, std::string>::value
+                      || std::is_convertible<Decoded, V>::value,
+                      "csv::Field: column type does not convert to the member");
+
+        static bool decode(std::string_view record, const std::vector<std::size_t> &ends, T &object)
+        {
+            std::size_t start = C == 0 ? 0 : ends[C - 1] + 1;
+
+            return decodeField<Decoded>(record.substr(start, ends[C] - start), object.*M);
+        }
+    };
+
+    /*
+    ** Compile-time binding of the members of T to columns, for instance
+    **   Mapping<Bid, Field<&Bid::title, 0>, Field<&Bid::amount, 4, Currency> >
+    ** Reader::read and Follower::read decode a record straight into a T
+    ** with it; a field of another struct does not build.
+    */
+    template<typename T, typename... Fields>
+    struct Mapping
+    {
+        typedef T Type;
+
+        static_assert(sizeof...(Fields) > 0, "csv::Mapping: no field");
+        static_assert((std::is_same<T, typename Fields::Type>::value && ...),
+                      "csv::Mapping: field of another struct");
+
+        // columns a record needs, the last mapped one included
+        static const unsigned int width = std::max({ (Fields::column + 1)... });
+
+        // false if a field does not convert; `ends` must be at least `width` long
+        static bool decode(std::string_view record, const std::vector<std::size_t> &ends, T &object)
+        {
+            return (Fields::decode(record, ends, object) && ...);
+        }
+    };
+
     enum DataType {
         eFILE = 0,
-        ePURE = 1
+        ePURE = 1,
+        eMMAP = 2
+    };
+
+    /*
+    ** Read-only memory mapping of a whole file, used by eMMAP parsers.
+    ** Rows parsed from it hold string_views into the mapping, so it
+    ** must outlive them (the Parser owns both).
+    */
+    class MappedFile
+    {
+      public:
+        MappedFile(void);
+        ~MappedFile(void);
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+      public:
+        bool open(const std::string &);
+        void close(void);
+        const char *data(void) const;
+        std::size_t size(void) const;
+
+      private:
+        const char *_data;
+        std::size_t _size;
+# ifdef _WIN32
+        void *_fileHandle;
+        void *_mapHandle;
+# endif
+    };
+
+    /*
+    ** Splits an input into records and fields (see CSVparser.cpp). Fields
+    ** are separated by `sep` and records by '\n', unless inside double
+    ** quotes (RFC 4180: a quoted field may hold both).
+    */
+    class FieldScanner
+    {
+      public:
+        FieldScanner(std::string_view, char sep);
+
+      public:
+        bool next(std::string_view &record, std::vector<std::size_t> &ends);
+        // newlines passed so far, those inside quoted fields included
+        std::size_t lines(void) const;
+
+      private:
+        void load(std::size_t block);
+
+        std::string_view _data;
+        const char _sep;
+        std::size_t _pos;
+        std::size_t _lines;
+        // index and bitmaps (separators, quotes, newlines) of the current 64-byte block
+        std::size_t _block;
+        std::uint64_t _masks[3];
+    };
+
+    /*
+    ** A record that a lenient Parser or Reader skipped because its number
+    ** of fields is not the header's, or, read through a Mapping, because
+    ** one of its fields does not convert.
+    */
+    struct Rejected
+    {
+        // line (the header being line 1) and byte offset where it starts
+        unsigned long line;
+        std::uint64_t offset;
+        std::size_t fields;
+        std::string text;
+    };
+
+    /*
+    ** How far a Reader or a Follower got into its file: the byte offset
+    ** where the next record starts, and the lines before it.
+    */
+    struct Position
+    {
+        std::uint64_t offset = 0;
+        unsigned long line = 0;
+    };
+
+    /*
+    ** Optional settings of a Parser or a Reader.
+    */
+    struct Options
+    {
+        // threads tokenizing the input in parallel, 0 for one per core
+        unsigned int threads = 1;
+        // only load these columns, by position and/or by header name
+        // (all of them when both are empty)
+        std::vector<unsigned int> columns;
+        std::vector<std::string> columnNames;
+        // read buffer of a Reader
+        std::size_t bufferSize = 65536;
+        // back the rows of a Parser with transparent huge pages when the
+        // system has them (2 MiB pages instead of 4 KiB: fewer TLB misses)
+        bool hugePages = false;
+        // Parser::sync appends the rows added and deleted since the last
+        // sync to "<file>.journal" instead of rewriting the whole file;
+        // the journal is replayed when the file is parsed again
+        bool journal = false;
+        // only index where the lines of a Parser start (8 bytes a row) and
+        // split a row the first time it is asked for, keeping the last
+        // `cacheRows` of them; such a parser is read-only, and throws on a
+        // malformed row when splitting it, lenient or not. It maps an eFILE
+        // file as eMMAP does instead of reading it in (ePURE content is
+        // still copied)
+        bool lazy = false;
+        std::size_t cacheRows = 16;
+        // skip malformed records and list them (see getRejected) instead
+        // of throwing on the first one
+        bool lenient = false;
+    };
+
+    /*
+    ** The rows of a Parser, in order. Every row sits in a slot of a fixed
+    ** array, which does not move while the row exists (freed slots are
+    ** reused); the order is an implicit treap over those slots, so
+    ** inserting or erasing at any position is O(log n) instead of a shift
+    ** of every later row. Positional access is O(log n), O(1) until the
+    ** first edit that is not at the end. A handle is a slot and the
+    ** generation of the row in it: that of a row erased (or cleared) never
+    ** names the row that takes its slot next.
+    */
+    class RowStore
+    {
+
+    public:
+        typedef std::uint64_t Handle;
+
+        RowStore(void);
+
+    public:
+        unsigned int size(void) const;
+        void assign(const std::vector<Row *> &);
+        Handle insert(unsigned int pos, Row *);
+        Row *erase(unsigned int pos);
+        void clear(void);
+        Row *at(unsigned int pos) const;
+        Handle handleAt(unsigned int pos) const;
+        // -1 if the row of the handle was erased
+        int positionOf(Handle) const;
+
+    private:
+        static const unsigned int NIL = ~0u;
+
+        struct Node
+        {
+            Row *row;
+            unsigned int left;
+            unsigned int right;
+            unsigned int parent;
+            // rows in the subtree, and the heap key that keeps it balanced
+            unsigned int size;
+            std::uint32_t priority;
+            // _generation when the row was put in the slot
+            std::uint32_t generation;
+        };
+
+        unsigned int sizeOf(unsigned int) const;
+        unsigned int find(unsigned int pos) const;
+        unsigned int allocate(Row *);
+        Handle handleOf(unsigned int) const;
+        void update(unsigned int);
+        void fix(unsigned int);
+        void split(unsigned int, unsigned int count, unsigned int &, unsigned int &);
+        unsigned int merge(unsigned int, unsigned int);
+
+        std::vector<Node> _nodes;
+        std::vector<unsigned int> _free;
+        unsigned int _root;
+        std::uint32_t _seed;
+        // one more on every erase and clear (wrapping after 2^32 of them)
+        std::uint32_t _generation;
+        // the rows in order, while no edit has made it stale
+        std::vector<Row *> _order;
+        bool _ordered;
     };
 
     class Parser
     {
 
     public:
-        Parser(const std::string &, const DataType &type = eFILE, char sep = ',');
+        Parser(const std::string &, const DataType &type = eFILE, char sep = ',',
+               const Options &options = Options());
         ~Parser(void);
 
     public:
+        // with Options::lazy, the row stays valid until `cacheRows` others are split
         Row &getRow(unsigned int row) const;
+        // handle of a row, which stays the same as rows are added or deleted
+        RowStore::Handle rowHandle(unsigned int row) const;
+        // current position of a row, -1 once it is deleted
+        int rowPosition(RowStore::Handle handle) const;
         unsigned int rowCount(void) const;
         unsigned int columnCount(void) const;
         std::vector<std::string> getHeader(void) const;
+        std::shared_ptr<const Schema> getSchema(void) const;
+        const std::vector<Rejected> &getRejected(void) const;
         const std::string getHeaderElement(unsigned int pos) const;
         const std::string &getFileName(void) const;
 
@@ -79,22 +558,536 @@ namespace csv
         bool deleteRow(unsigned int row);
         bool addRow(unsigned int pos, const std::vector<std::string> &);
         void sync(void) const;
+        // rewrite the file in place (atomically) and drop its journal
+        void compact(void) const;
 
     protected:
     	void parseHeader(void);
     	void parseContent(void);
+    	std::size_t parseRange(std::string_view, std::vector<Row *> &, std::pmr::memory_resource &,
+    	                       std::vector<Rejected> &) const;
+        std::pmr::memory_resource &newArena(std::size_t);
+        void replayJournal(void);
+        std::string journalPath(void) const;
+        void indexLines(void);
+        Row &lazyRow(unsigned int) const;
 
     private:
         std::string _file;
         const DataType _type;
         const char _sep;
-        std::vector<std::string> _originalFile;
-        std::vector<std::string> _header;
-        std::vector<Row *> _content;
+        const Options _options;
+        mutable MappedFile _map;
+        std::string _buffer;
+        // whole input (mapping or _buffer) while parsing
+        std::string_view _data;
+        std::shared_ptr<const Schema> _schema;
+        // line and byte offset of the first line after the header
+        unsigned long _contentLine;
+        std::uint64_t _contentOffset;
+        std::vector<Rejected> _rejected;
+        // rows and their fields are carved out of these (one per parsing
+        // thread) and never freed one by one: they all go with the parser
+        std::vector<std::unique_ptr<std::pmr::monotonic_buffer_resource> > _arenas;
+        RowStore _content;
+        // journal entries not synced yet, and the size of the journal file
+        mutable std::string _pending;
+        mutable std::uint64_t _journalSize;
+        // lazy mode: start of every line in _data, and the rows last split
+        // (most recent first) with their positions
+        std::vector<std::uint64_t> _lines;
+        mutable std::list<std::pair<unsigned int, std::unique_ptr<Row> > > _cache;
+        mutable std::unordered_map<unsigned int,
+          std::list<std::pair<unsigned int, std::unique_ptr<Row> > >::iterator> _cached;
 
     public:
         Row &operator[](unsigned int row) const;
     };
+
+    /*
+    ** Streams the rows of a file, or of stdin when the path is "-", through
+    ** a fixed-size read buffer without ever holding the whole input.
+    ** The row returned by next() views the buffer: it is only valid until
+    ** the following call.
+    */
+    class Reader
+    {
+
+    public:
+        Reader(const std::string &, char sep = ',', const Options &options = Options());
+        Reader(std::istream &, char sep = ',', const Options &options = Options());
+        ~Reader(void);
+        Reader(const Reader &) = delete;
+        Reader &operator=(const Reader &) = delete;
+
+    public:
+        const Row *next(void);
+        std::vector<std::string> getHeader(void) const;
+        std::shared_ptr<const Schema> getSchema(void) const;
+        const std::vector<Rejected> &getRejected(void) const;
+        unsigned long lineNumber(void) const;
+        Position position(void) const;
+        // about as many rows as are left, for sizing what they go into:
+        // the bytes of the file not read yet over the length of the lines
+        // in the buffer, without reading any more of it; 0 for a stream
+        std::size_t rowEstimate(void) const;
+
+        /*
+        ** Decode the next row straight into `object` through the Mapping M,
+        ** without building a Row. False at the end of the input.
+        */
+        template<typename M>
+        bool read(typename M::Type &object)
+        {
+            std::string_view record;
+
+            if (M::width > _schema->size())
+                throw Error("mapped column out of range");
+            while (nextRecord(record))
+            {
+                if (M::decode(record, _ends, object))
+                    return true;
+                reject(record);
+            }
+            return false;
+        }
+
+    protected:
+        void readHeader(const std::string &);
+        bool readLine(std::string_view &);
+        bool nextRecord(std::string_view &);
+        void reject(std::string_view);
+
+    private:
+        // empty when reading a stream
+        const std::string _path;
+        std::ifstream _file;
+        std::istream *_in;
+        const char _sep;
+        const Options _options;
+        std::vector<char> _buffer;
+        std::size_t _begin;
+        std::size_t _end;
+        bool _eof;
+        unsigned long _lineNumber;
+        // bytes of the input handed out so far
+        std::uint64_t _offset;
+        // where the record last split starts
+        unsigned long _recordLine;
+        std::uint64_t _recordOffset;
+        std::shared_ptr<const Schema> _schema;
+        std::unique_ptr<Row> _row;
+        std::vector<std::size_t> _ends;
+        std::vector<Rejected> _rejected;
+    };
+
+    /*
+    ** Call `callback(const Row &)` for every row of a file (see Reader),
+    ** returning the number of rows read.
+    */
+    template<typename F>
+    unsigned long forEachRow(const std::string &path, F callback, char sep = ',',
+                             const Options &options = Options())
+    {
+        Reader reader(path, sep, options);
+        unsigned long count = 0;
+
+        while (const Row *row = reader.next())
+        {
+            callback(*row);
+            count++;
+        }
+        return count;
+    }
+
+    /*
+    ** Follows a file that keeps growing at its end, like a live feed: the
+    ** first poll hands out every row it holds, later ones only the records
+    ** appended since, so each costs what was added. The file is polled (a
+    ** stat, cheap enough to do before every prompt) and read from where the
+    ** last complete record ended; a record still missing its newline waits
+    ** for the next poll. A file that shrank was truncated or replaced and is
+    ** read again from its start. As with Reader, the row returned by next()
+    ** is only valid until the following call. A file already read up to
+    ** some position (by a Reader) is followed from there with resume().
+    */
+    class Follower
+    {
+
+    public:
+        Follower(const std::string &, char sep = ',', const Options &options = Options());
+        ~Follower(void);
+        Follower(const Follower &) = delete;
+        Follower &operator=(const Follower &) = delete;
+
+    public:
+        const Row *next(void);
+        std::shared_ptr<const Schema> getSchema(void) const;
+        const std::vector<Rejected> &getRejected(void) const;
+        unsigned long lineNumber(void) const;
+        std::uint64_t offset(void) const;
+        // skip the records before `from` on the first poll, the header
+        // still being read; ignored if the file is shorter by then
+        void resume(const Position &from);
+
+        /*
+        ** Call `callback(const Row &)` for every row added to the file since
+        ** the last poll, returning their number.
+        */
+        template<typename F>
+        unsigned long poll(F callback)
+        {
+            unsigned long count = 0;
+
+            while (const Row *row = next())
+            {
+                callback(*row);
+                count++;
+            }
+            return count;
+        }
+
+        /*
+        ** Decode the next row added into `object` through the Mapping M
+        ** (see Reader::read). False when none is left for now.
+        */
+        template<typename M>
+        bool read(typename M::Type &object)
+        {
+            std::string_view record;
+
+            while (nextRecord(record))
+            {
+                if (M::width > _schema->size())
+                    throw Error("mapped column out of range");
+                if (M::decode(record, _ends, object))
+                    return true;
+                reject(record);
+            }
+            return false;
+        }
+
+    protected:
+        bool fill(void);
+        bool readLine(std::string_view &);
+        bool nextRecord(std::string_view &);
+        void reject(std::string_view);
+
+    private:
+        const std::string _path;
+        std::ifstream _file;
+        const char _sep;
+        const Options _options;
+        // bytes read from the file and not handed out yet start at _begin;
+        // _scanned of them were searched for a newline, ending in quotes if
+        // _quoted and over _scannedLines lines
+        std::string _buffer;
+        std::size_t _begin;
+        std::size_t _scanned;
+        bool _quoted;
+        unsigned long _scannedLines;
+        unsigned long _lineNumber;
+        // bytes of the file read, and handed out as records
+        std::uint64_t _read;
+        std::uint64_t _offset;
+        unsigned long _recordLine;
+        std::uint64_t _recordOffset;
+        // where to go on from once the header is read
+        Position _resume;
+        std::shared_ptr<const Schema> _schema;
+        std::unique_ptr<Row> _row;
+        std::vector<std::size_t> _ends;
+        std::vector<Rejected> _rejected;
+    };
+
+    /*
+    ** The files named in `paths`, a directory standing for the files
+    ** ending in `extension` that it holds, in name order.
+    */
+    std::vector<std::string> listFiles(const std::vector<std::string> &paths,
+                                       const std::string &extension = ".csv");
+
+    /*
+    ** What readFiles got out of one file: its rows turned into T, the
+    ** records skipped by a lenient Reader, where the Reader stopped, and
+    ** the message of the Error that stopped it (empty if none).
+    */
+    template<typename T>
+    struct FileRows
+    {
+        std::string path;
+        std::vector<T> rows;
+        std::vector<Rejected> rejected;
+        Position end;
+        std::string error;
+    };
+
+    /*
+    ** Read several files at once, on up to Options::threads threads (0 for
+    ** one per core) taking the files in turn, each with `readAll(Reader &,
+    ** std::vector<T> &)`. The result is in the order of `paths`, whichever
+    ** file was done first.
+    */
+    template<typename T, typename R>
+    std::vector<FileRows<T> > readFilesWith(const std::vector<std::string> &paths, R readAll,
+                                            char sep, const Options &options)
+    {
+        std::vector<FileRows<T> > files(paths.size());
+        std::vector<std::exception_ptr> errors(paths.size());
+        std::atomic<std::size_t> nextFile(0);
+
+        auto work = [&]() {
+            for (std::size_t i = nextFile++; i < paths.size(); i = nextFile++)
+            {
+                files[i].path = paths[i];
+                try
+                {
+                    Reader reader(paths[i], sep, options);
+
+                    readAll(reader, files[i].rows);
+                    files[i].rejected = reader.getRejected();
+                    files[i].end = reader.position();
+                }
+                catch (const Error &e)
+                {
+                    files[i].error = e.what();
+                }
+                catch (...)
+                {
+                    errors[i] = std::current_exception();
+                }
+            }
+        };
+
+        std::size_t threads = options.threads != 0 ? options.threads
+                              : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::thread> workers;
+
+        threads = std::min(threads, paths.size());
+        for (std::size_t i = 1; i < threads; i++)
+            workers.emplace_back(work);
+        work();
+        for (auto it = workers.begin(); it != workers.end(); it++)
+            it->join();
+        for (auto it = errors.begin(); it != errors.end(); it++)
+            if (*it)
+                std::rethrow_exception(*it);
+        return files;
+    }
+
+    /*
+    ** readFilesWith turning every row into a T with `convert(const Row &)`.
+    */
+    template<typename T, typename F>
+    std::vector<FileRows<T> > readFiles(const std::vector<std::string> &paths, F convert,
+                                        char sep = ',', const Options &options = Options())
+    {
+        return readFilesWith<T>(paths, [&convert](Reader &reader, std::vector<T> &rows) {
+            while (const Row *row = reader.next())
+                rows.push_back(convert(*row));
+        }, sep, options);
+    }
+
+    /*
+    ** readFilesWith decoding every row through the Mapping M (Reader::read).
+    */
+    template<typename M>
+    std::vector<FileRows<typename M::Type> > readFiles(const std::vector<std::string> &paths,
+                                                       char sep = ',', const Options &options = Options())
+    {
+        typedef typename M::Type T;
+
+        return readFilesWith<T>(paths, [](Reader &reader, std::vector<T> &rows) {
+            T object;
+
+            while (reader.read<M>(object))
+                rows.push_back(object);
+        }, sep, options);
+    }
+
+    enum ColumnType {
+        eAUTO = 0,
+        eTEXT = 1,
+        eNUMBER = 2,
+        eCURRENCY = 3,
+        ePERCENT = 4
+    };
+
+    /*
+    ** Column-oriented copy of a CSV file: every numeric column is one
+    ** contiguous array of doubles and every text column one byte buffer
+    ** plus an array of end offsets, instead of a Row object per line and
+    ** a string per field. Meant for scans over a few columns of many rows.
+    **
+    ** Columns are indexed by their position in the file; with a projection
+    ** (Options::columns) only the loaded ones are kept. A column typed eAUTO
+    ** becomes eCURRENCY, ePERCENT or eNUMBER if all of its values convert,
+    ** eTEXT otherwise; a money column whose values have fractions of a cent
+    ** is eNUMBER.
+    */
+    class ColumnTable
+    {
+
+    public:
+        ColumnTable(const std::string &path, const std::vector<ColumnType> &types = std::vector<ColumnType>(),
+                    char sep = ',', const Options &options = Options());
+        ColumnTable(const Parser &, const std::vector<ColumnType> &types = std::vector<ColumnType>());
+        ~ColumnTable(void);
+
+    public:
+        unsigned int rowCount(void) const;
+        unsigned int columnCount(void) const;
+        const Schema &getSchema(void) const;
+        ColumnType getType(unsigned int column) const;
+        const std::vector<double> &numbers(unsigned int column) const;
+        // the exact amounts of an eCURRENCY column
+        const std::vector<Money> &amounts(unsigned int column) const;
+        std::string_view text(unsigned int column, unsigned int row) const;
+
+    public:
+        double sum(unsigned int column) const;
+        std::vector<unsigned int> filter(unsigned int column, std::string_view value) const;
+
+    protected:
+        void append(const Row &);
+        void finish(void);
+
+    private:
+        struct Column
+        {
+            ColumnType type;
+            std::vector<double> numbers;
+            // eCURRENCY only: the same values, in cents
+            std::vector<Money> amounts;
+            std::string bytes;
+            std::vector<std::size_t> ends;
+        };
+
+        const Column &column(unsigned int) const;
+
+        std::shared_ptr<const Schema> _schema;
+        // one per loaded column, in the order of Schema::columns()
+        std::vector<Column> _columns;
+        unsigned int _rows;
+    };
+
+    /*
+    ** Records of a fixed layout (so many texts, numbers and integers)
+    ** saved to a binary file in place of the CSV file they were read from:
+    ** a versioned header keyed by the size and modification time of that
+    ** file, the text end offsets, one block of text bytes, the numbers as
+    ** doubles and the integers as 64-bit integers (cents and the like, kept
+    ** exact), and how far the file was read for them. Loading it back is
+    ** four block reads, with no parsing. Snapshots go to a cache directory,
+    ** never next to the data.
+    */
+    class Snapshot
+    {
+
+    public:
+        static const std::uint32_t VERSION = 3;
+
+        Snapshot(unsigned int texts, unsigned int numbers, unsigned int integers = 0);
+        ~Snapshot(void);
+
+    public:
+        // "<temp>/csv-snapshots/<name>-<hash of its full path>.snap", empty
+        // if the system has no temporary directory
+        static std::string pathFor(const std::string &source);
+
+        // false if there is no snapshot of the current `source` at `path`
+        bool load(const std::string &path, const std::string &source);
+        // `end` is where the records of `source` stopped
+        bool save(const std::string &path, const std::string &source,
+                  const Position &end = Position()) const;
+        // that of the snapshot loaded
+        const Position &sourceEnd(void) const;
+
+    public:
+        unsigned int size(void) const;
+        void append(std::initializer_list<std::string_view> texts,
+                    std::initializer_list<double> numbers,
+                    std::initializer_list<std::int64_t> integers = {});
+        std::string_view text(unsigned int record, unsigned int field) const;
+        double number(unsigned int record, unsigned int field) const;
+        std::int64_t integer(unsigned int record, unsigned int field) const;
+        void clear(void);
+
+    private:
+        const unsigned int _texts;
+        const unsigned int _numbers;
+        const unsigned int _integers;
+        std::string _bytes;
+        // end of every text in _bytes, record after record
+        std::vector<std::uint64_t> _ends;
+        std::vector<double> _values;
+        std::vector<std::int64_t> _integerValues;
+        Position _sourceEnd;
+    };
+
+    /*
+    ** Keeps every distinct string once and names it by a 32-bit handle,
+    ** for fields with few distinct values (a fund, a department): a handle
+    ** is 4 bytes where a std::string is 32, and two handles are equal when
+    ** their texts are. Strings are never removed and never move, so a text
+    ** stays valid as long as the pool. Safe to share between threads.
+    */
+    class StringPool
+    {
+
+    public:
+        typedef std::uint32_t Handle;
+
+        // the empty string is always handle 0
+        StringPool(void);
+        StringPool(const StringPool &) = delete;
+        StringPool &operator=(const StringPool &) = delete;
+
+    public:
+        Handle intern(std::string_view);
+        std::string_view text(Handle) const;
+        std::size_t size(void) const;
+        // bytes of text held, each distinct string once
+        std::size_t bytes(void) const;
+
+        // the pool of Interned strings
+        static StringPool &shared(void);
+
+    private:
+        mutable std::shared_mutex _lock;
+        std::pmr::monotonic_buffer_resource _storage;
+        std::vector<std::string_view> _texts;
+        std::unordered_map<std::string_view, Handle> _handles;
+        std::size_t _bytes;
+    };
+
+    /*
+    ** A string interned in StringPool::shared(), to use as a field type
+    ** (including through a Mapping): compared by handle, read back as a
+    ** string_view.
+    */
+    class Interned
+    {
+
+    public:
+        Interned(void) : _handle(0) {}
+        Interned(std::string_view text) : _handle(StringPool::shared().intern(text)) {}
+        Interned(const std::string &text) : Interned(std::string_view(text)) {}
+        Interned(const char *text) : Interned(std::string_view(text)) {}
+
+    public:
+        std::string_view str(void) const { return StringPool::shared().text(_handle); }
+        operator std::string_view(void) const { return str(); }
+        StringPool::Handle handle(void) const { return _handle; }
+        bool empty(void) const { return _handle == 0; }
+        bool operator==(const Interned &other) const { return _handle == other._handle; }
+        bool operator!=(const Interned &other) const { return _handle != other._handle; }
+
+    private:
+        StringPool::Handle _handle;
+    };
+
+    std::ostream &operator<<(std::ostream &, const Interned &);
 }
 
 #endif /*!_CSVPARSER_HPP_*/
@@ -0,0 +1,390 @@
+//============================================================================
+// Name        : CSVparserCheck.cpp
+// Author      : David Towne
+// Version     : 1.0
+// Copyright   : Copyright © 2017 SNHU COCE
+// Description : Checks csv::Parser against the original line-by-line parser
+//============================================================================
+//
+// Not part of the HashTable program. Build and run it from this directory,
+// with the CSV files next to it:
+//
+//   g++ -std=c++17 -O2 -pthread CSVparser.cpp CSVparserCheck.cpp -o CSVparserCheck
+//   ./CSVparserCheck [file.csv ...]
+//
+// It exits with 1 after listing what differs, and with 0 otherwise.
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CSVparser.hpp"
+
+using namespace std;
+
+// a parsed file: its header, then its rows
+typedef vector<vector<string>> Table;
+
+static unsigned long failures = 0;
+
+static void fail(const string& what) {
+    if (failures++ < 20) {
+        cerr << "FAIL: " << what << endl;
+    }
+}
+
+//============================================================================
+// The reference: the parser as it was before the tokenizer was vectorized,
+// one line and one character at a time
+//============================================================================
+
+/**
+ * Parse CSV text the way the original csv::Parser did
+ *
+ * @param data The CSV text
+ * @param sep The separator of the header
+ * @param table Receives the header and the rows
+ * @return false where the original parser threw
+ */
+static bool referenceParse(const string& data, char sep, Table& table) {
+    vector<string> lines;
+    string line;
+    istringstream stream(data);
+    while (getline(stream, line)) {
+        if (line != "") {
+            lines.push_back(line);
+        }
+    }
+    if (lines.empty()) {
+        return false;
+    }
+
+    table.assign(1, vector<string>());
+    stringstream header(lines[0]);
+    string item;
+    while (getline(header, item, sep)) {
+        table[0].push_back(item);
+    }
+
+    for (size_t l = 1; l < lines.size(); l++) {
+        const string& text = lines[l];
+        vector<string> row;
+        bool quoted = false;
+        size_t tokenStart = 0;
+        for (size_t i = 0; i != text.length(); i++) {
+            if (text[i] == '"') {
+                quoted = !quoted;
+            } else if (text[i] == sep && !quoted) {
+                row.push_back(text.substr(tokenStart, i - tokenStart));
+                tokenStart = i + 1;
+            }
+        }
+        row.push_back(text.substr(tokenStart));
+        if (row.size() != table[0].size()) {
+            return false;
+        }
+        table.push_back(row);
+    }
+    return true;
+}
+
+/**
+ * Split text into records and fields the way FieldScanner documents it,
+ * one byte at a time: quotes toggle a quoted region, in which separators
+ * and newlines are part of the field
+ *
+ * @param data The text
+ * @param sep The field separator
+ * @param records Receives, per record, its text and its field ends
+ * @param lines Receives, per record, the newlines passed once it is read
+ */
+static void referenceScan(const string& data, char sep,
+        vector<pair<string, vector<size_t>>>& records, vector<size_t>& lines) {
+    size_t pos = 0;
+    size_t newlines = 0;
+    while (pos < data.size()) {
+        size_t start = pos;
+        bool quoted = false;
+        vector<size_t> ends;
+        for (; pos < data.size(); pos++) {
+            char c = data[pos];
+            if (c == '"') {
+                quoted = !quoted;
+            } else if (c == '\n') {
+                newlines++;
+                if (!quoted) {
+                    break;
+                }
+            } else if (c == sep && !quoted) {
+                ends.push_back(pos - start);
+            }
+        }
+        ends.push_back(pos - start);
+        records.push_back(make_pair(data.substr(start, pos - start), ends));
+        lines.push_back(newlines);
+        pos++;
+    }
+}
+
+//============================================================================
+// What the parser under test makes of the same input
+//============================================================================
+
+static void addRow(const csv::Row& row, unsigned int columns, Table& table) {
+    vector<string> fields;
+    for (unsigned int i = 0; i < columns; i++) {
+        fields.push_back(row[i]);
+    }
+    table.push_back(fields);
+}
+
+/**
+ * Parse with a csv::Parser
+ *
+ * @return false if it threw
+ */
+static bool parserParse(const string& input, csv::DataType type, const csv::Options& options,
+        Table& table) {
+    try {
+        csv::Parser parser(input, type, ',', options);
+        table.assign(1, parser.getHeader());
+        for (unsigned int i = 0; i < parser.rowCount(); i++) {
+            addRow(parser.getRow(i), parser.columnCount(), table);
+        }
+        return true;
+    } catch (csv::Error&) {
+        return false;
+    }
+}
+
+/**
+ * Parse with a streaming csv::Reader
+ *
+ * @return false if it threw
+ */
+static bool readerParse(const string& path, const csv::Options& options, Table& table) {
+    try {
+        csv::Reader reader(path, ',', options);
+        table.assign(1, reader.getHeader());
+        while (const csv::Row* row = reader.next()) {
+            addRow(*row, static_cast<unsigned int>(table[0].size()), table);
+        }
+        return true;
+    } catch (csv::Error&) {
+        return false;
+    }
+}
+
+static void compare(const string& what, bool expectedOk, const Table& expected,
+        bool ok, const Table& actual) {
+    if (ok != expectedOk) {
+        fail(what + (ok ? ": parsed input the original parser rejects"
+                        : ": rejected input the original parser reads"));
+        return;
+    }
+    if (!ok) {
+        return;
+    }
+    if (actual.size() != expected.size()) {
+        fail(what + ": " + to_string(actual.size() - 1) + " rows instead of "
+                + to_string(expected.size() - 1));
+        return;
+    }
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (actual[i] != expected[i]) {
+            fail(what + ": " + (i == 0 ? string("header") : "row " + to_string(i)) + " differs");
+            return;
+        }
+    }
+}
+
+/**
+ * Parse a file every way the parser can, each compared to the original
+ *
+ * @param path The CSV file
+ * @param name How to call it in failures
+ */
+static void checkFile(const string& path, const string& name) {
+    ifstream in(path, ios::binary);
+    string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+    Table expected;
+    bool expectedOk = referenceParse(data, ',', expected);
+
+    const csv::DataType types[] = { csv::eFILE, csv::eMMAP };
+    const char* typeNames[] = { "eFILE", "eMMAP" };
+    const unsigned int threads[] = { 1, 8, 0 };
+    for (int t = 0; t < 2; t++) {
+        for (unsigned int n : threads) {
+            csv::Options options;
+            options.threads = n;
+            Table actual;
+            bool ok = parserParse(path, types[t], options, actual);
+            compare(name + " " + typeNames[t] + " threads=" + to_string(n), expectedOk, expected,
+                    ok, actual);
+        }
+        csv::Options lazy;
+        lazy.lazy = true;
+        Table actual;
+        bool ok = parserParse(path, types[t], lazy, actual);
+        compare(name + " " + typeNames[t] + " lazy", expectedOk, expected, ok, actual);
+    }
+
+    Table actual;
+    bool ok = parserParse(data, csv::ePURE, csv::Options(), actual);
+    compare(name + " ePURE", expectedOk, expected, ok, actual);
+
+    // a small buffer, so records straddle refills
+    csv::Options small;
+    small.bufferSize = 100;
+    ok = readerParse(path, small, actual);
+    compare(name + " Reader", expectedOk, expected, ok, actual);
+}
+
+//============================================================================
+// Random input
+//============================================================================
+
+/**
+ * A field with an even number of quotes, so that it ends where the original
+ * parser ends it: plain text, a quoted field holding separators, quotes
+ * inside text, or nothing
+ */
+static string randomField(mt19937& random) {
+    static const char letters[] = "abcXYZ019 $.-\t";
+    string field;
+    switch (random() % 6) {
+    case 0:
+        break;
+    case 1:
+        field = "\"a, \"\"b\"\", c\"";
+        break;
+    case 2:
+        field = "x\"y,z\"w";
+        break;
+    default:
+        for (unsigned int n = random() % 12; n > 0; n--) {
+            field += letters[random() % (sizeof(letters) - 1)];
+        }
+    }
+    return field;
+}
+
+/**
+ * CSV text of `rows` rows of `columns` fields, with the odd empty line,
+ * carriage return or missing last newline
+ */
+static string randomCsv(mt19937& random, unsigned int columns, unsigned int rows) {
+    string data;
+    for (unsigned int c = 0; c < columns; c++) {
+        data += "col" + to_string(c) + (c + 1 < columns ? "," : "\n");
+    }
+    for (unsigned int r = 0; r < rows; r++) {
+        for (unsigned int c = 0; c < columns; c++) {
+            data += randomField(random);
+            if (c + 1 < columns) {
+                data += ',';
+            }
+        }
+        if (random() % 20 == 0) {
+            data += '\r';
+        }
+        data += '\n';
+        if (random() % 30 == 0) {
+            data += '\n';
+        }
+    }
+    if (random() % 2 == 0 && !data.empty()) {
+        data.pop_back();
+    }
+    return data;
+}
+
+/**
+ * Compare FieldScanner to the byte-by-byte split on random text full of
+ * separators, quotes and newlines, across 64-byte block boundaries
+ */
+static void fuzzScanner(mt19937& random, unsigned int rounds) {
+    static const char bytes[] = { ',', ';', '"', '\n', '\r', 'a', ' ', '\t', '\0', '\x80', '\xff' };
+    const char seps[] = { ',', ';', '\t' };
+
+    for (unsigned int round = 0; round < rounds; round++) {
+        char sep = seps[random() % 3];
+        size_t length = random() % 300;
+        string data;
+        for (size_t i = 0; i < length; i++) {
+            data += bytes[random() % sizeof(bytes)];
+        }
+
+        vector<pair<string, vector<size_t>>> expected;
+        vector<size_t> expectedLines;
+        referenceScan(data, sep, expected, expectedLines);
+
+        csv::FieldScanner scanner(data, sep);
+        string_view record;
+        vector<size_t> ends;
+        size_t count = 0;
+        for (; scanner.next(record, ends); count++) {
+            if (count >= expected.size() || record != expected[count].first
+                    || ends != expected[count].second || scanner.lines() != expectedLines[count]) {
+                fail("FieldScanner round " + to_string(round) + ", record " + to_string(count));
+                break;
+            }
+        }
+        if (count < expected.size()) {
+            fail("FieldScanner round " + to_string(round) + ": " + to_string(count)
+                    + " records instead of " + to_string(expected.size()));
+        }
+    }
+}
+
+/**
+ * The one and only main() method
+ */
+int main(int argc, char* argv[]) {
+    vector<string> paths;
+    for (int i = 1; i < argc; i++) {
+        paths.push_back(argv[i]);
+    }
+    if (paths.empty()) {
+        paths.push_back("eBid_Monthly_Sales_Dec_2016.csv");
+        paths.push_back("eBid_Monthly_Sales.csv");
+    }
+
+    for (const string& path : paths) {
+        if (!filesystem::exists(path)) {
+            fail(path + " not found");
+            continue;
+        }
+        checkFile(path, path);
+    }
+
+    mt19937 random(20161201);
+    fuzzScanner(random, 20000);
+
+    // random files, a large one to be cut among threads
+    string path = (filesystem::temp_directory_path() / "CSVparserCheck.csv").string();
+    const unsigned int sizes[] = { 0, 1, 3, 40, 500, 20000 };
+    for (unsigned int round = 0; round < 30; round++) {
+        unsigned int rows = sizes[round % 6];
+        string data = randomCsv(random, 1 + random() % 9, rows);
+        {
+            ofstream out(path, ios::binary | ios::trunc);
+            out << data;
+        }
+        checkFile(path, "random file " + to_string(round) + " (" + to_string(rows) + " rows)");
+    }
+    remove(path.c_str());
+
+    if (failures > 0) {
+        cerr << failures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "csv::Parser matches the original parser" << endl;
+    return 0;
+}
@@ -6,13 +6,27 @@
 // Description : Hello World in C++, Ansi-style
 //============================================================================
 
-#include <algorithm>
-#include <climits>
+#include <cstdint>
+#include <filesystem>
 #include <iostream>
-#include <string> // atoi
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string_view>
 #include <time.h>
 
-#include "CSVparser.hpp"
+#include "Bid.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define HASH_SSE2 1
+# include <emmintrin.h>
+#else
+# define HASH_SSE2 0
+#endif
+#ifdef _MSC_VER
+# include <intrin.h>
+#endif
 
 using namespace std;
 
@@ -22,19 +36,6 @@ using namespace std;
 
 const unsigned int DEFAULT_SIZE = 179;
 
-// forward declarations
-double strToDouble(string str, char ch);
-
-// define a structure to hold bid information
-struct Bid {
-    string bidId; // unique identifier
-    string title;
-    string fund;
-    double amount;
-    Bid() {
-        amount = 0.0;
-    }
-};
 //============================================================================
 // Hash Table class definition
 //============================================================================
@@ -42,6 +43,18 @@ struct Bid {
 /**
  * Define a class containing data members and methods to
  * implement a hash table with chaining.
+ *
+ * The table grows with its bids: past one bid per bucket on average it
+ * moves to a table twice the size, a few buckets at a time, on each of
+ * the following inserts and searches, so that no single one of them
+ * waits for every bid to be rehashed.
+ *
+ * Tables are a power of two buckets: the bucket of a key is the top bits
+ * of its hash times 2^64 / phi (Fibonacci hashing), with no division.
+ *
+ * Bids with the same id are all kept, each chained after the ones before
+ * it: Search and Remove find the one inserted first. SwissTable does the
+ * same.
  */
 class HashTable {
 
@@ -49,50 +62,76 @@ private:
     // Define structures to hold bids
     struct Node {
         Bid bid;
-        unsigned int key;
+        BidKey::Type key;
         Node *next;
 
         // default constructor
         Node() {
-            key = UINT_MAX;
+            key = BidKey::none();
             next = nullptr;
         }
 
-        // initialize with a bid
-        Node(Bid aBid) : Node() {
-            bid = aBid;
+        // initialize with a bid, taking over its strings
+        Node(Bid&& aBid) : Node() {
+            bid = move(aBid);
         }
 
-        // initialize with a bid and a key
-        Node(Bid aBid, unsigned int aKey) : Node(aBid) {
+        // initialize with a bid and its key
+        Node(Bid&& aBid, BidKey::Type aKey) : Node(move(aBid)) {
             key = aKey;
         }
     };
 
-    vector<Node> nodes;
+    // bids per bucket, on average, past which the table grows
+    static constexpr double MAX_LOAD = 1.0;
+    // 2^64 / phi, odd
+    static const uint64_t FIBONACCI = 11400714819323198485ull;
+    // buckets of the old table moved by each insert or search
+    static const unsigned int MIGRATE_STEP = 2;
+
+    // the first node of the chain of each bucket; searches do their
+    // share of moving buckets too
+    mutable vector<Node*> nodes;
+    // the table being moved into nodes, while the table grows
+    mutable vector<Node*> oldNodes;
+    // buckets of oldNodes moved so far
+    mutable unsigned int migrated = 0;
 
-    unsigned int tableSize = DEFAULT_SIZE;
+    // 2^tableBits buckets
+    unsigned int tableBits = 0;
+    unsigned int tableSize = 1;
+    unsigned int oldBits = 0;
+    size_t count = 0;
 
-    unsigned int hash(int key);
+    static unsigned int bitsFor(size_t size);
+    unsigned int hash(const BidKey::Type& key, unsigned int bits) const;
+    unsigned int bitsOf(const vector<Node*>& buckets) const;
+    void addNode(vector<Node*>& buckets, Node* node) const;
+    void grow(unsigned int bits);
+    void migrate(unsigned int buckets) const;
+    vector<Node*>& bucketsOf(const BidKey::Type& key) const;
+    void freeChains(vector<Node*>& buckets);
 
 public:
     HashTable();
     HashTable(unsigned int size);
     virtual ~HashTable();
-    void Insert(Bid bid);
+    void reserve(size_t bids);
+    void Insert(Bid&& bid);
+    void Insert(const Bid& bid);
     void PrintAll();
-    void Remove(string bidId);
-    Bid Search(string bidId);
+    void PrintStats();
+    void Remove(string_view bidId);
+    const Bid* Search(string_view bidId) const;
+    const Bid* Find(string_view bidId) const;
+    size_t Size() const;
 };
 
 /**
  * Default constructor
  */
-HashTable::HashTable() {
+HashTable::HashTable() : HashTable(DEFAULT_SIZE) {
     // FIXME (1): Initialize the structures used to hold bids
-    
-    // Initalize node structure by resizing tableSize
-	nodes.resize(tableSize);
 }
 
 /**
@@ -101,8 +140,11 @@ HashTable::HashTable() {
  * by reducing collisions without wasting memory.
  */
 HashTable::HashTable(unsigned int size) {
-    // invoke local tableSize to size with this->
+    // invoke local tableSize to size with this->, rounded up to a power of two
+    this->tableBits = bitsFor(size);
+    this->tableSize = 1u << tableBits;
     // resize nodes size
+    nodes.resize(tableSize, nullptr);
 }
 
 
@@ -111,66 +153,183 @@ HashTable::HashTable(unsigned int size) {
  */
 HashTable::~HashTable() {
     // FIXME (2): Implement logic to free storage when class is destroyed
-    
-    // erase nodes beginning
-	nodes.erase(nodes.begin());
+
+    // free the nodes of every chain
+    freeChains(nodes);
+    freeChains(oldNodes);
+}
+
+/**
+ * Delete the nodes of the buckets of a table
+ *
+ * @param buckets The table
+ */
+void HashTable::freeChains(vector<Node*>& buckets) {
+    for (Node*& bucket : buckets) {
+        while (bucket != nullptr) {
+            Node* next = bucket->next;
+            delete bucket;
+            bucket = next;
+        }
+    }
+}
+
+/**
+ * The bits of the smallest power of two of at least size buckets
+ */
+unsigned int HashTable::bitsFor(size_t size) {
+    unsigned int bits = 0;
+    while ((size_t(1) << bits) < size) {
+        bits++;
+    }
+    return bits;
 }
 
 /**
  * Calculate the hash value of a given key.
- * Note that key is specifically defined as
- * unsigned int to prevent undefined results
- * of a negative list index.
+ * Note that the hash is taken from the top
+ * bits of the product, so it is always less
+ * than 2^bits, never a negative list index.
  *
  * @param key The key to hash
+ * @param bits The table has 2^bits buckets
  * @return The calculated hash
  */
-unsigned int HashTable::hash(int key) {
+unsigned int HashTable::hash(const BidKey::Type& key, unsigned int bits) const {
     // FIXME (3): Implement logic to calculate a hash value
-    // return key tableSize
-	return key % tableSize;
+    // spread by the hash policy, then reduced to the table by multiplying
+    if (bits == 0) {
+        return 0;
+    }
+	return static_cast<unsigned int>((BidHash::hash(key) * FIBONACCI) >> (64 - bits));
+}
+
+/**
+ * The bits of the size of either table
+ */
+unsigned int HashTable::bitsOf(const vector<Node*>& buckets) const {
+    return &buckets == &oldNodes ? oldBits : tableBits;
+}
+
+/**
+ * Make room for a number of bids at once, rehashing
+ * the bids already held right away
+ *
+ * @param bids The number of bids the table will hold
+ */
+void HashTable::reserve(size_t bids) {
+    unsigned int bits = bitsFor(static_cast<size_t>(bids / MAX_LOAD));
+    if (bits > tableBits) {
+        grow(bits);
+        migrate(static_cast<unsigned int>(oldNodes.size()));
+    }
+}
+
+/**
+ * Start moving the bids to a table of a new size; the
+ * moves happen in migrate()
+ *
+ * @param bits The new table has 2^bits buckets
+ */
+void HashTable::grow(unsigned int bits) {
+    // a table still being moved is moved first
+    migrate(static_cast<unsigned int>(oldNodes.size()));
+
+    // only an array of pointers to allocate: the nodes stay where they are
+    oldNodes = move(nodes);
+    oldBits = tableBits;
+    migrated = 0;
+    tableBits = bits;
+    tableSize = 1u << tableBits;
+    nodes.assign(tableSize, nullptr);
+}
+
+/**
+ * Move the nodes of some more buckets of the old table
+ * to the new one, and drop the old one once it is empty
+ *
+ * @param buckets The number of buckets to move
+ */
+void HashTable::migrate(unsigned int buckets) const {
+    for (; buckets > 0 && migrated < oldNodes.size(); buckets--, migrated++) {
+        // relinked in the new table, bids and all
+        Node* node = oldNodes[migrated];
+        while (node != nullptr) {
+            Node* next = node->next;
+            addNode(nodes, node);
+            node = next;
+        }
+        oldNodes[migrated] = nullptr;
+    }
+    if (!oldNodes.empty() && migrated == oldNodes.size()) {
+        vector<Node*>().swap(oldNodes);
+        migrated = 0;
+    }
 }
 
 /**
- * Insert a bid
+ * The table holding the bucket of a key: the old one
+ * until that bucket is moved
+ *
+ * @param key The key of the bid
+ */
+vector<HashTable::Node*>& HashTable::bucketsOf(const BidKey::Type& key) const {
+    if (!oldNodes.empty() && hash(key, oldBits) >= migrated) {
+        return oldNodes;
+    }
+    return nodes;
+}
+
+/**
+ * Add a node to the end of the chain of its bucket
+ *
+ * @param buckets The table to add to
+ * @param node The node to add
+ */
+void HashTable::addNode(vector<Node*>& buckets, Node* node) const {
+	node->next = nullptr;
+	// retrieve node using key
+	Node** oldNod = &(buckets.at(hash(node->key, bitsOf(buckets))));
+	// do the hash chaining
+	while (*oldNod != nullptr) {
+		oldNod = &(*oldNod)->next;
+	}
+	// add new node to end
+	*oldNod = node;
+}
+
+/**
+ * Insert a bid, moving it into the table
  *
  * @param bid The bid to insert
  */
-void HashTable::Insert(Bid bid) {
+void HashTable::Insert(Bid&& bid) {
     // FIXME (5): Implement logic to insert a bid
     // create the key for the given bid
-    int key = hash(atoi(bid.bidId.c_str()));
-	// retrieve node using key
-	// retrieve node using key
-	Node* oldNod = &(nodes.at(key));
-	// if no entry found for the key
-	if (oldNod != nullptr) {
-		// Node found
-		if (oldNod->key == UINT_MAX) {
-			// assign this node to the key position
-			oldNod->key = key;
-			oldNod->bid = bid;
-			oldNod->next = nullptr;
-		}
-		// else if node is not used
-		else {
-			// do the hash chaining
-			while (true) {
-				if (oldNod->next == nullptr) {
-					break;
-				}
-				oldNod = oldNod->next;
-			}
-			// add new newNode to end
-			oldNod->next = new Node(bid, key);
-		}
-	}
-	// else find the next open node
-	else {
-		Node* newNod = new Node(bid, key);
-		nodes.insert(nodes.begin() + key, *newNod);
-	}
-	
+    BidKey::Type key;
+    if (!BidKey::parse(bid.bidId, key)) {
+        cerr << "Bid id " << bid.bidId << " is not a valid key, skipped" << endl;
+        return;
+    }
+
+    migrate(MIGRATE_STEP);
+    // grow once the table is full, unless it is growing already; doubling
+    // leaves room for as many inserts as there are buckets to move
+    if (oldNodes.empty() && count + 1 > tableSize * MAX_LOAD) {
+        grow(tableBits + 1);
+    }
+    // into the old table while its bucket is there, to be moved with it
+    addNode(bucketsOf(key), new Node(move(bid), key));
+    count++;
+}
+
+/**
+ * Insert a copy of a bid
+ *
+ * @param bid The bid to insert
+ */
+void HashTable::Insert(const Bid& bid) {
+    Insert(Bid(bid));
 }
 
 /**
@@ -178,22 +337,53 @@ void HashTable::Insert(Bid bid) {
  */
 void HashTable::PrintAll() {
     // FIXME (6): Implement logic to print all bids
-	// for node begin to end iterate
-	for (int i = 0; i < nodes.size(); i++) {
-		Bid bid = nodes[i].bid;
-        if (bid.amount > 0) {
-			cout << bid.bidId << ": " << bid.title << " | " << bid.amount << " | "
-			<< bid.fund << endl;
-        }
+	// the buckets not moved yet, then the new table
+	for (const vector<Node*>* buckets : { &oldNodes, &nodes }) {
+		size_t first = buckets == &oldNodes ? migrated : 0;
+		// for node begin to end iterate
+		for (size_t i = first; i < buckets->size(); i++) {
+			// output bidID, title, amount and fund
+			// node is equal to next iter
+			// while node not equal to nullptr
+			for (const Node* node = (*buckets)[i]; node != nullptr; node = node->next) {
+				displayBid(node->bid);
+			}
+		}
 	}
-    
-    //   if key not equal to UINT_MAx
-            // output key, bidID, title, amount and fund
-            // node is equal to next iter
-            // while node not equal to nullptr
-               // output key, bidID, title, amount and fund
-               // node is equal to next node
-	
+}
+
+/**
+ * Print how evenly the bids spread over the buckets: how
+ * many chains there are of each length, and how many
+ * nodes a search for a bid held reads on average
+ */
+void HashTable::PrintStats() {
+    // a growth in progress is finished first, so that there is one table
+    migrate(static_cast<unsigned int>(oldNodes.size()));
+
+    // chains of 0, 1, ... 7 nodes, then of 8 or more
+    vector<size_t> lengths(9, 0);
+    size_t longest = 0;
+    size_t reads = 0;
+    for (const Node* bucket : nodes) {
+        size_t length = 0;
+        for (const Node* node = bucket; node != nullptr; node = node->next) {
+            length++;
+            // the i-th node of a chain is found after reading i nodes
+            reads += length;
+        }
+        lengths[min<size_t>(length, lengths.size() - 1)]++;
+        longest = max(longest, length);
+    }
+
+    cout << "Buckets: " << tableSize << endl;
+    cout << "Bids: " << count << " (" << (double) count / tableSize << " per bucket)" << endl;
+    for (size_t i = 0; i < lengths.size(); i++) {
+        cout << "  chains of " << i << (i + 1 == lengths.size() ? "+" : "")
+                << " bids: " << lengths[i] << endl;
+    }
+    cout << "Longest chain: " << longest << endl;
+    cout << "Nodes read per search: " << (count > 0 ? (double) reads / count : 0) << endl;
 }
 
 /**
@@ -201,158 +391,667 @@ void HashTable::PrintAll() {
  *
  * @param bidId The bid id to search for
  */
-void HashTable::Remove(string bidId) {
+void HashTable::Remove(string_view bidId) {
     // FIXME (7): Implement logic to remove a bid
-    // set key equal to hash atoi bidID cstring
-	unsigned key = hash(atoi(bidId.c_str()));
-	// erase node begin and key
-    nodes.erase(nodes.begin() + key); 
+	BidKey::Type key;
+	if (!BidKey::parse(bidId, key)) {
+		return;
+	}
+	vector<Node*>& buckets = bucketsOf(key);
+	// the link to each node, from the table or the node before it
+	for (Node** link = &(buckets.at(hash(key, bitsOf(buckets)))); *link != nullptr;
+			link = &(*link)->next) {
+		if ((*link)->key == key) {
+			// unlink the node, then free it
+			Node* node = *link;
+			*link = node->next;
+			delete node;
+			count--;
+			return;
+		}
+	}
 }
 
 /**
  * Search for the specified bidId
  *
  * @param bidId The bid id to search for
+ * @return the bid found, held by the table, or nullptr
  */
-Bid HashTable::Search(string bidId) {
-    Bid bid;
+const Bid* HashTable::Search(string_view bidId) const {
+    migrate(MIGRATE_STEP);
+    return Find(bidId);
+}
 
+/**
+ * Search for the specified bidId, changing nothing: not
+ * even a growth in progress moves along, so any number
+ * of threads may search at once
+ *
+ * @param bidId The bid id to search for
+ * @return the bid found, held by the table, or nullptr
+ */
+const Bid* HashTable::Find(string_view bidId) const {
     // FIXME (8): Implement logic to search for and return a bid
 
     // create the key for the given bid
-    int key = hash(atoi(bidId.c_str()));
-	Node* node = &(nodes.at(key));
-
-    // if entry found for the key
-    if (node != nullptr && node->key != UINT_MAX
-			&& node->bid.bidId.compare(bidId) == 0) {
-		//return node bid
-		return node->bid;
-	}
-    // if no entry found for the key     
-	if (node == nullptr || node->key == UINT_MAX) {
-		// return bid
-		return bid;
-	}
-    
-      
+    BidKey::Type key;
+    if (!BidKey::parse(bidId, key)) {
+        return nullptr;
+    }
+
+    const vector<Node*>& buckets = bucketsOf(key);
+	const Node* node = buckets.at(hash(key, bitsOf(buckets)));
+
     // while node not equal to nullptr
 	while (node != nullptr) {
 		// if the current node matches, return it
-		if (node->key != UINT_MAX && node->bid.bidId.compare(bidId) == 0) {
-			return node->bid;
+		if (node->key == key) {
+			return &node->bid;
 		}
 		//node is equal to next node
 		node = node->next;
 	}
-    return bid;
+    return nullptr;
+}
+
+/**
+ * Returns the current size (number of bids) in the table
+ */
+size_t HashTable::Size() const {
+    return count;
 }
 
 //============================================================================
-// Static methods used for testing
+// Swiss table class definition
 //============================================================================
 
 /**
- * Display the bid information to the console (std::out)
+ * Define a class with the methods of HashTable, implemented as an
+ * open-addressing "Swiss" table: a byte of metadata per slot (empty, or
+ * 7 bits of the hash of the key held) kept apart from the bids, probed
+ * 16 slots at a time with one SSE2 compare. A lookup reads one or two
+ * cache lines of metadata, then only the slots whose 7 bits match.
+ *
+ * Slots are probed linearly from the one the hash picks, so a removal
+ * shifts the following bids back into the hole instead of leaving a
+ * tombstone: probes always stop at the first empty slot.
  *
- * @param bid struct containing the bid info
+ * Bids with the same id are all kept, as in HashTable: a later one lands
+ * further along the probe, which neither removals nor growth reorder, so
+ * Search and Remove find the one inserted first.
  */
-void displayBid(Bid bid) {
-    cout << bid.bidId << ": " << bid.title << " | " << bid.amount << " | "
-            << bid.fund << endl;
-    return;
+class SwissTable {
+
+private:
+    // control byte of an empty slot; a full one holds 0 to 127
+    static constexpr int8_t EMPTY = -128;
+    // slots probed at a time
+    static constexpr size_t GROUP = 16;
+
+    struct Slot {
+        BidKey::Type key;
+        Bid bid;
+    };
+
+    // one control byte per slot, then the first GROUP - 1 of them again
+    // so that a group read near the end needs no wrap around
+    vector<int8_t> ctrl;
+    vector<Slot> slots;
+    size_t count = 0;
+
+    static size_t hash(const BidKey::Type& key);
+    static unsigned int lowestBit(uint32_t bits);
+    uint32_t match(size_t pos, int8_t h2) const;
+    uint32_t matchEmpty(size_t pos) const;
+    void setCtrl(size_t pos, int8_t value);
+    size_t find(const BidKey::Type& key) const;
+    void place(BidKey::Type&& key, Bid&& bid);
+    void grow();
+
+public:
+    SwissTable();
+    virtual ~SwissTable();
+    void reserve(size_t bids);
+    void Insert(Bid&& bid);
+    void Insert(const Bid& bid);
+    void PrintAll();
+    void PrintStats();
+    void Remove(string_view bidId);
+    const Bid* Search(string_view bidId) const;
+};
+
+/**
+ * Default constructor
+ */
+SwissTable::SwissTable() {
+    // the first power of two past DEFAULT_SIZE
+    size_t capacity = GROUP;
+    while (capacity < DEFAULT_SIZE) {
+        capacity *= 2;
+    }
+    ctrl.assign(capacity + GROUP - 1, EMPTY);
+    slots.resize(capacity);
+}
+
+/**
+ * Destructor
+ */
+SwissTable::~SwissTable() {
+    // the vectors free the slots
 }
 
 /**
- * Load a CSV file containing bids into a container
+ * Calculate the hash value of a given key, with its bits
+ * mixed: the low 7 go to the control byte and the others
+ * pick the first slot probed
  *
- * @param csvPath the path to the CSV file to load
- * @return a container holding all the bids read
+ * @param key The key to hash
+ * @return The calculated hash
  */
-void loadBids(string csvPath, HashTable* hashTable) {
-    cout << "Loading CSV file " << csvPath << endl;
+size_t SwissTable::hash(const BidKey::Type& key) {
+    // mixed once more, for hash policies that leave numbers as they are
+    uint64_t h = BidHash::hash(key) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(h ^ (h >> 32));
+}
 
-    // initialize the CSV Parser using the given path
-    csv::Parser file = csv::Parser(csvPath);
+/**
+ * The position of the lowest bit set in a match
+ */
+unsigned int SwissTable::lowestBit(uint32_t bits) {
+#ifdef _MSC_VER
+    unsigned long pos;
+    _BitScanForward(&pos, bits);
+    return pos;
+#else
+    return __builtin_ctz(bits);
+#endif
+}
 
-    // read and display header row - optional
-    vector<string> header = file.getHeader();
-    for (auto const& c : header) {
-        cout << c << " | ";
+/**
+ * The slots of the group starting at pos whose control byte is h2,
+ * one bit per slot
+ */
+uint32_t SwissTable::match(size_t pos, int8_t h2) const {
+#if HASH_SSE2
+    __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&ctrl[pos]));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2)));
+#else
+    uint32_t bits = 0;
+    for (size_t i = 0; i < GROUP; i++) {
+        if (ctrl[pos + i] == h2) {
+            bits |= 1u << i;
+        }
     }
-    cout << "" << endl;
+    return bits;
+#endif
+}
 
-    try {
-        // loop to read rows of a CSV file
-        for (unsigned int i = 0; i < file.rowCount(); i++) {
+/**
+ * The empty slots of the group starting at pos, one bit per slot
+ */
+uint32_t SwissTable::matchEmpty(size_t pos) const {
+#if HASH_SSE2
+    // EMPTY is the only control byte with its top bit set
+    __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&ctrl[pos]));
+    return _mm_movemask_epi8(group);
+#else
+    return match(pos, EMPTY);
+#endif
+}
 
-            // Create a data structure and add to the collection of bids
-            Bid bid;
-            bid.bidId = file[i][1];
-            bid.title = file[i][0];
-            bid.fund = file[i][8];
-            bid.amount = strToDouble(file[i][4], '$');
+/**
+ * Set the control byte of a slot, and of its copy past the end
+ */
+void SwissTable::setCtrl(size_t pos, int8_t value) {
+    ctrl[pos] = value;
+    if (pos < GROUP - 1) {
+        ctrl[slots.size() + pos] = value;
+    }
+}
 
-            //cout << "Item: " << bid.title << ", Fund: " << bid.fund << ", Amount: " << bid.amount << endl;
+/**
+ * Find the slot of a key
+ *
+ * @return its position, or slots.size() if it is not in the table
+ */
+size_t SwissTable::find(const BidKey::Type& key) const {
+    size_t mask = slots.size() - 1;
+    size_t h = hash(key);
+    int8_t h2 = h & 0x7F;
+    size_t pos = (h >> 7) & mask;
 
-            // push this bid to the end
-            hashTable->Insert(bid);
+    while (true) {
+        // the 7 bits rule out all but a few slots of the group
+        for (uint32_t hits = match(pos, h2); hits != 0; hits &= hits - 1) {
+            size_t slot = (pos + lowestBit(hits)) & mask;
+            if (slots[slot].key == key) {
+                return slot;
+            }
+        }
+        // the key would be before the first empty slot
+        if (matchEmpty(pos) != 0) {
+            return slots.size();
         }
-    } catch (csv::Error &e) {
-        std::cerr << e.what() << std::endl;
+        pos = (pos + GROUP) & mask;
     }
 }
 
 /**
- * Simple C function to convert a string to a double
- * after stripping out unwanted char
+ * Put a bid into the first empty slot from the one its
+ * hash picks, past any bids with the same key
+ */
+void SwissTable::place(BidKey::Type&& key, Bid&& bid) {
+    size_t mask = slots.size() - 1;
+    size_t h = hash(key);
+    size_t pos = (h >> 7) & mask;
+
+    uint32_t empty;
+    while ((empty = matchEmpty(pos)) == 0) {
+        pos = (pos + GROUP) & mask;
+    }
+    pos = (pos + lowestBit(empty)) & mask;
+
+    setCtrl(pos, h & 0x7F);
+    slots[pos].key = move(key);
+    slots[pos].bid = move(bid);
+    count++;
+}
+
+/**
+ * Double the number of slots, placing every bid again in
+ * probe order, so that bids with the same key keep theirs
+ */
+void SwissTable::grow() {
+    vector<int8_t> oldCtrl = move(ctrl);
+    vector<Slot> oldSlots = move(slots);
+
+    ctrl.assign(oldSlots.size() * 2 + GROUP - 1, EMPTY);
+    slots = vector<Slot>(oldSlots.size() * 2);
+    count = 0;
+    // from an empty slot, so that no run of probed slots is cut in two
+    size_t mask = oldSlots.size() - 1;
+    size_t start = 0;
+    while (oldCtrl[start] != EMPTY) {
+        start++;
+    }
+    for (size_t n = 1; n <= oldSlots.size(); n++) {
+        size_t i = (start + n) & mask;
+        if (oldCtrl[i] != EMPTY) {
+            place(move(oldSlots[i].key), move(oldSlots[i].bid));
+        }
+    }
+}
+
+/**
+ * Make room for a number of bids at once
+ *
+ * @param bids The number of bids the table will hold
+ */
+void SwissTable::reserve(size_t bids) {
+    while (bids * 8 > slots.size() * 7) {
+        grow();
+    }
+}
+
+/**
+ * Insert a bid, moving it into the table; one already there
+ * with the same id is kept, and found first
+ *
+ * @param bid The bid to insert
+ */
+void SwissTable::Insert(Bid&& bid) {
+    BidKey::Type key;
+    if (!BidKey::parse(bid.bidId, key)) {
+        cerr << "Bid id " << bid.bidId << " is not a valid key, skipped" << endl;
+        return;
+    }
+
+    // at most 7/8 full, so that probes find an empty slot soon
+    if ((count + 1) * 8 > slots.size() * 7) {
+        grow();
+    }
+    place(move(key), move(bid));
+}
+
+/**
+ * Insert a copy of a bid
+ *
+ * @param bid The bid to insert
+ */
+void SwissTable::Insert(const Bid& bid) {
+    Insert(Bid(bid));
+}
+
+/**
+ * Print all bids
+ */
+void SwissTable::PrintAll() {
+    for (size_t i = 0; i < slots.size(); i++) {
+        if (ctrl[i] != EMPTY) {
+            displayBid(slots[i].bid);
+        }
+    }
+}
+
+/**
+ * Print how far the bids sit from the slot their hash
+ * picks, which is what a search for them probes past
+ */
+void SwissTable::PrintStats() {
+    size_t mask = slots.size() - 1;
+    size_t distance = 0;
+    size_t longest = 0;
+    size_t groups = 0;
+    for (size_t i = 0; i < slots.size(); i++) {
+        if (ctrl[i] == EMPTY) {
+            continue;
+        }
+        size_t home = (hash(slots[i].key) >> 7) & mask;
+        size_t d = (i - home) & mask;
+        distance += d;
+        longest = max(longest, d);
+        groups += d / GROUP + 1;
+    }
+
+    cout << "Slots: " << slots.size() << endl;
+    cout << "Bids: " << count << " (" << (double) count / slots.size() << " per slot)" << endl;
+    cout << "Slots from home: " << (count > 0 ? (double) distance / count : 0)
+            << " on average, " << longest << " at most" << endl;
+    cout << "Groups read per search: " << (count > 0 ? (double) groups / count : 0) << endl;
+}
+
+/**
+ * Remove a bid, moving the bids probed after it back
+ * so that no probe stops short of them
+ *
+ * @param bidId The bid id to search for
+ */
+void SwissTable::Remove(string_view bidId) {
+    BidKey::Type key;
+    if (!BidKey::parse(bidId, key)) {
+        return;
+    }
+    size_t hole = find(key);
+    if (hole == slots.size()) {
+        return;
+    }
+
+    size_t mask = slots.size() - 1;
+    for (size_t next = (hole + 1) & mask; ctrl[next] != EMPTY; next = (next + 1) & mask) {
+        size_t home = (hash(slots[next].key) >> 7) & mask;
+        // a bid moves back unless it would land before its first slot
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            slots[hole] = move(slots[next]);
+            setCtrl(hole, ctrl[next]);
+            hole = next;
+        }
+    }
+    setCtrl(hole, EMPTY);
+    // free the strings of the bid left behind
+    slots[hole] = Slot();
+    count--;
+}
+
+/**
+ * Search for the specified bidId
+ *
+ * @param bidId The bid id to search for
+ * @return the bid found, held by the table, or nullptr
+ */
+const Bid* SwissTable::Search(string_view bidId) const {
+    BidKey::Type key;
+    if (!BidKey::parse(bidId, key)) {
+        return nullptr;
+    }
+    size_t slot = find(key);
+    return slot != slots.size() ? &slots[slot].bid : nullptr;
+}
+
+//============================================================================
+// Sharded table class definition
+//============================================================================
+
+/**
+ * Define a class with the methods of HashTable that many threads may call
+ * at once: the bids are split by hash over SHARDS hash tables, each behind
+ * its own reader-writer lock. Searches of a shard share its lock, so
+ * readers only wait for a write to the same shard, one in SHARDS of them.
+ *
+ * Search returns a copy of the bid, taken under the lock: a pointer into a
+ * shard could be freed by a Remove on another thread.
+ */
+class ShardedTable {
+
+private:
+    // a power of two, well past the cores of a machine
+    static const unsigned int SHARDS = 64;
+
+    // a cache line each, so that locking one does not slow its neighbours
+    struct alignas(64) Shard {
+        mutable shared_mutex lock;
+        HashTable table;
+    };
+
+    Shard shards[SHARDS];
+
+    Shard& shardOf(string_view bidId);
+    const Shard& shardOf(string_view bidId) const;
+
+public:
+    ShardedTable();
+    virtual ~ShardedTable();
+    void reserve(size_t bids);
+    void Insert(Bid&& bid);
+    void Insert(const Bid& bid);
+    void PrintAll();
+    void PrintStats();
+    void Remove(string_view bidId);
+    optional<Bid> Search(string_view bidId) const;
+};
+
+/**
+ * Default constructor
+ */
+ShardedTable::ShardedTable() {
+    // each shard starts as a default HashTable
+}
+
+/**
+ * Destructor
+ */
+ShardedTable::~ShardedTable() {
+    // each shard frees its own table
+}
+
+/**
+ * The shard of an auction ID: the low 6 bits of its hash. The
+ * table of the shard picks a bucket from the whole hash, but
+ * those bits are the same for all its bids: they only add a
+ * constant to the Fibonacci product, and the other 58 bits
+ * spread the bids over the buckets
  *
- * credit: http://stackoverflow.com/a/24875936
+ * @param bidId The bid id
+ */
+ShardedTable::Shard& ShardedTable::shardOf(string_view bidId) {
+    BidKey::Type key;
+    // an ID that is not a key is turned away by the table of shard 0
+    if (!BidKey::parse(bidId, key)) {
+        return shards[0];
+    }
+    return shards[BidHash::hash(key) & (SHARDS - 1)];
+}
+
+const ShardedTable::Shard& ShardedTable::shardOf(string_view bidId) const {
+    return const_cast<ShardedTable*>(this)->shardOf(bidId);
+}
+
+/**
+ * Make room for a number of bids at once, spread evenly
+ * over the shards
+ *
+ * @param bids The number of bids the table will hold
+ */
+void ShardedTable::reserve(size_t bids) {
+    for (Shard& shard : shards) {
+        unique_lock<shared_mutex> lock(shard.lock);
+        shard.table.reserve(bids / SHARDS + 1);
+    }
+}
+
+/**
+ * Insert a bid, moving it into the table
  *
- * @param ch The character to strip out
+ * @param bid The bid to insert
  */
-double strToDouble(string str, char ch) {
-    str.erase(remove(str.begin(), str.end(), ch), str.end());
-    return atof(str.c_str());
+void ShardedTable::Insert(Bid&& bid) {
+    Shard& shard = shardOf(bid.bidId);
+    unique_lock<shared_mutex> lock(shard.lock);
+    shard.table.Insert(move(bid));
 }
 
+/**
+ * Insert a copy of a bid
+ *
+ * @param bid The bid to insert
+ */
+void ShardedTable::Insert(const Bid& bid) {
+    Insert(Bid(bid));
+}
+
+/**
+ * Print all bids, one shard at a time
+ */
+void ShardedTable::PrintAll() {
+    for (Shard& shard : shards) {
+        unique_lock<shared_mutex> lock(shard.lock);
+        shard.table.PrintAll();
+    }
+}
+
+/**
+ * Print how evenly the bids spread over the shards
+ */
+void ShardedTable::PrintStats() {
+    size_t total = 0;
+    size_t fewest = SIZE_MAX;
+    size_t most = 0;
+    for (const Shard& shard : shards) {
+        shared_lock<shared_mutex> lock(shard.lock);
+        size_t size = shard.table.Size();
+        total += size;
+        fewest = min(fewest, size);
+        most = max(most, size);
+    }
+
+    cout << "Shards: " << SHARDS << endl;
+    cout << "Bids: " << total << " (" << fewest << " to " << most << " per shard)" << endl;
+}
+
+/**
+ * Remove a bid
+ *
+ * @param bidId The bid id to search for
+ */
+void ShardedTable::Remove(string_view bidId) {
+    Shard& shard = shardOf(bidId);
+    unique_lock<shared_mutex> lock(shard.lock);
+    shard.table.Remove(bidId);
+}
+
+/**
+ * Search for the specified bidId
+ *
+ * @param bidId The bid id to search for
+ * @return a copy of the bid found, or nothing
+ */
+optional<Bid> ShardedTable::Search(string_view bidId) const {
+    const Shard& shard = shardOf(bidId);
+    shared_lock<shared_mutex> lock(shard.lock);
+    // Find, unlike Search, leaves the table as it is for other readers
+    const Bid* bid = shard.table.Find(bidId);
+    if (bid == nullptr) {
+        return nullopt;
+    }
+    return *bid;
+}
+
+// the hash table of the program: build with BID_SWISS_TABLE for the
+// open-addressing one, or BID_SHARDED_TABLE for the thread-safe one
+#if defined(BID_SWISS_TABLE)
+typedef SwissTable BidTable;
+#elif defined(BID_SHARDED_TABLE)
+typedef ShardedTable BidTable;
+#else
+typedef HashTable BidTable;
+#endif
+
+//============================================================================
+// Static methods used for testing
+//============================================================================
+
+// checks that include this file define HASHTABLE_NO_MAIN for their own main()
+#ifndef HASHTABLE_NO_MAIN
+
 /**
  * The one and only main() method
  */
 int main(int argc, char* argv[]) {
 
-    // process command line arguments
-    string csvPath, bidKey;
-    switch (argc) {
-    case 2:
-        csvPath = argv[1];
-        bidKey = "98109";
-        break;
-    case 3:
-        csvPath = argv[1];
-        bidKey = argv[2];
-        break;
-    default:
-        csvPath = "eBid_Monthly_Sales_Dec_2016.csv";
-        bidKey = "98109";
+    // process command line arguments: CSV files (or directories of them),
+    // then the bid key unless the last one is a file too
+    vector<string> csvPaths;
+    string bidKey = "98109";
+    for (int i = 1; i < argc; i++) {
+        if (i > 1 && i == argc - 1 && !filesystem::exists(argv[i])) {
+            bidKey = argv[i];
+        } else {
+            csvPaths.push_back(argv[i]);
+        }
+    }
+    if (csvPaths.empty()) {
+        csvPaths.push_back("eBid_Monthly_Sales_Dec_2016.csv");
     }
+    csvPaths = csv::listFiles(csvPaths);
 
     // Define a timer variable
     clock_t ticks;
 
     // Define a hash table to hold all the bids
-    HashTable* bidTable;
+    BidTable* bidTable;
 
-    Bid bid;
-    bidTable = new HashTable();
+    bidTable = new BidTable();
+
+    // the loaders move every bid they read into the table
+    BidSink addBid = [bidTable](Bid&& bid) {
+        bidTable->Insert(move(bid));
+    };
+    // and size it for them first
+    BidReserve reserveBids = [bidTable](size_t bids) {
+        bidTable->reserve(bids);
+    };
     
+    // the newest CSV file, followed from choice 5 on: it is polled for
+    // new bids before every prompt
+    csv::Follower* follower = nullptr;
+    // where the last load stopped in that file
+    csv::Position loaded;
+
     int choice = 0;
     while (choice != 9) {
+        if (follower != nullptr) {
+            unsigned long added = followBids(follower, addBid);
+            if (added > 0) {
+                cout << added << " new bids in " << csvPaths.back() << endl;
+            }
+        }
         cout << "Menu:" << endl;
         cout << "  1. Load Bids" << endl;
         cout << "  2. Display All Bids" << endl;
         cout << "  3. Find Bid" << endl;
         cout << "  4. Remove Bid" << endl;
+        cout << "  5. Follow Bids" << endl;
+        cout << "  6. Hash Statistics" << endl;
         cout << "  9. Exit" << endl;
         cout << "Enter choice: ";
         cin >> choice;
@@ -365,7 +1064,11 @@ int main(int argc, char* argv[]) {
             ticks = clock();
 
             // Complete the method call to load the bids
-            loadBids(csvPath, bidTable);
+            if (csvPaths.size() == 1) {
+                loaded = loadBids(csvPaths[0], addBid, reserveBids);
+            } else {
+                loaded = loadAllBids(csvPaths, addBid, reserveBids);
+            }
 
             // Calculate elapsed time and display result
             ticks = clock() - ticks; // current clock ticks minus starting clock ticks
@@ -377,15 +1080,16 @@ int main(int argc, char* argv[]) {
             bidTable->PrintAll();
             break;
 
-        case 3:
+        case 3: {
             ticks = clock();
 
-            bid = bidTable->Search(bidKey);
+            // the bid held by the table, or a copy of it
+            auto found = bidTable->Search(bidKey);
 
             ticks = clock() - ticks; // current clock ticks minus starting clock ticks
 
-            if (!bid.bidId.empty()) {
-                displayBid(bid);
+            if (found) {
+                displayBid(*found);
             } else {
                 cout << "Bid Id " << bidKey << " not found." << endl;
             }
@@ -393,14 +1097,41 @@ int main(int argc, char* argv[]) {
             cout << "time: " << ticks << " clock ticks" << endl;
             cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
             break;
+        }
 
         case 4:
             bidTable->Remove(bidKey);
             break;
+
+        case 5:
+            // load the bids of the newest file not loaded yet, then keep
+            // adding the ones appended to it
+            if (follower == nullptr) {
+                csv::Options options;
+                options.lenient = true;
+                follower = new csv::Follower(csvPaths.back(), ',', options);
+                follower->resume(loaded);
+            }
+            ticks = clock();
+
+            cout << followBids(follower, addBid) << " bids read from " << csvPaths.back() << endl;
+
+            ticks = clock() - ticks; // current clock ticks minus starting clock ticks
+            cout << "time: " << ticks << " clock ticks" << endl;
+            cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
+            break;
+
+        case 6:
+            bidTable->PrintStats();
+            break;
         }
     }
 
+    delete follower;
+
     cout << "Good bye." << endl;
 
     return 0;
 }
+
+#endif /*!HASHTABLE_NO_MAIN*/
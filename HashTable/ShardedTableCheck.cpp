@@ -0,0 +1,138 @@
+//============================================================================
+// Name        : ShardedTableCheck.cpp
+// Author      : David Towne
+// Version     : 1.0
+// Copyright   : Copyright © 2017 SNHU COCE
+// Description : Checks ShardedTable with readers and writers on many threads
+//============================================================================
+//
+// Not part of the HashTable program, whose classes it builds without its
+// main(). Build and run it from this directory:
+//
+//   g++ -std=c++17 -O2 -pthread CSVparser.cpp Bid.cpp ShardedTableCheck.cpp -o ShardedTableCheck
+//   ./ShardedTableCheck
+//
+// Build it with -O1 -g -fsanitize=thread instead of -O2 to have
+// ThreadSanitizer report any data race between the threads as well.
+//
+// It exits with 1 after listing what went wrong, and with 0 otherwise.
+
+#define HASHTABLE_NO_MAIN
+#include "HashTable.cpp"
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+// bids inserted before the threads start and never removed
+static const unsigned int STABLE = 20000;
+static const unsigned int READERS = 4;
+static const unsigned int WRITERS = 4;
+// bids each writer inserts and removes over and over
+static const unsigned int PER_WRITER = 5000;
+static const unsigned int ROUNDS = 20;
+
+static atomic<unsigned long> failures(0);
+
+static void fail(const string& what) {
+    if (failures++ < 20) {
+        cerr << "FAIL: " << what << endl;
+    }
+}
+
+static Bid makeBid(unsigned int id) {
+    Bid bid;
+    bid.bidId = to_string(id);
+    // the title tells a bid apart from a torn or misplaced copy
+    bid.title = "bid " + bid.bidId;
+    bid.fund = "General Fund";
+    bid.amount = csv::Money::fromCents(id);
+    return bid;
+}
+
+static bool isBid(const optional<Bid>& bid, unsigned int id) {
+    return bid && bid->bidId == to_string(id) && bid->title == "bid " + to_string(id)
+            && bid->amount.cents() == id;
+}
+
+/**
+ * Search stable bids, which must always be found, and the bids
+ * of the writers, which must be whole when they are
+ */
+static void reader(const ShardedTable& table, unsigned int seed, const atomic<bool>& done) {
+    mt19937 random(seed);
+    while (!done) {
+        unsigned int id = random() % STABLE;
+        if (!isBid(table.Search(to_string(id)), id)) {
+            fail("stable bid " + to_string(id) + " not found");
+        }
+        id = STABLE + random() % (WRITERS * PER_WRITER);
+        optional<Bid> bid = table.Search(to_string(id));
+        if (bid && !isBid(bid, id)) {
+            fail("bid " + to_string(id) + " found damaged");
+        }
+    }
+}
+
+/**
+ * Insert and remove bids of its own, leaving the odd ones in
+ */
+static void writer(ShardedTable& table, unsigned int first) {
+    for (unsigned int round = 0; round < ROUNDS; round++) {
+        for (unsigned int id = first; id < first + PER_WRITER; id++) {
+            table.Insert(makeBid(id));
+        }
+        for (unsigned int id = first; id < first + PER_WRITER; id++) {
+            if (round + 1 < ROUNDS || id % 2 == 0) {
+                table.Remove(to_string(id));
+            }
+        }
+    }
+}
+
+/**
+ * The one and only main() method
+ */
+int main() {
+    ShardedTable table;
+    for (unsigned int id = 0; id < STABLE; id++) {
+        table.Insert(makeBid(id));
+    }
+
+    atomic<bool> done(false);
+    vector<thread> readers;
+    for (unsigned int i = 0; i < READERS; i++) {
+        readers.emplace_back(reader, cref(table), i, cref(done));
+    }
+    // the shards grow as the writers go, under the readers
+    vector<thread> writers;
+    for (unsigned int i = 0; i < WRITERS; i++) {
+        writers.emplace_back(writer, ref(table), STABLE + i * PER_WRITER);
+    }
+    for (thread& t : writers) {
+        t.join();
+    }
+    done = true;
+    for (thread& t : readers) {
+        t.join();
+    }
+
+    for (unsigned int id = 0; id < STABLE + WRITERS * PER_WRITER; id++) {
+        bool kept = id < STABLE || id % 2 == 1;
+        optional<Bid> bid = table.Search(to_string(id));
+        if (kept && !isBid(bid, id)) {
+            fail("bid " + to_string(id) + " lost");
+        } else if (!kept && bid) {
+            fail("bid " + to_string(id) + " not removed");
+        }
+    }
+
+    if (failures > 0) {
+        cerr << failures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "ShardedTable kept every bid through " << READERS << " readers and "
+            << WRITERS << " writers" << endl;
+    return 0;
+}
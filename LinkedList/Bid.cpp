@@ -0,0 +1,327 @@
+//============================================================================
+// Name        : Bid.cpp
+// Author      : David Towne
+// Version     : 1.0
+// Copyright   : Copyright © 2017 SNHU COCE
+// Description : Bid record and loaders shared by the bid containers
+//============================================================================
+
+#include <cstring>
+#include <iostream>
+#include <unordered_set>
+
+#include "Bid.hpp"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+# include <intrin.h>
+#endif
+
+using namespace std;
+
+/**
+ * Display the bid information to the console (std::out)
+ *
+ * @param bid struct containing the bid info
+ */
+void displayBid(const Bid& bid) {
+    cout << bid.bidId << ": " << bid.title << " | " << bid.amount << " | "
+            << bid.fund << endl;
+    return;
+}
+
+/**
+ * Prompt user for bid information using console (std::in)
+ *
+ * @return Bid struct containing the bid info
+ */
+Bid getBid() {
+    Bid bid;
+
+    cout << "Enter Id: ";
+    cin.ignore();
+    getline(cin, bid.bidId);
+
+    cout << "Enter title: ";
+    getline(cin, bid.title);
+
+    cout << "Enter fund: ";
+    string fund;
+    cin >> fund;
+    bid.fund = fund;
+
+    cout << "Enter amount: ";
+    cin.ignore();
+    string strAmount;
+    getline(cin, strAmount);
+    // "$3,000.50" as well as "3000.5"
+    csv::toMoney(strAmount, bid.amount);
+
+    return bid;
+}
+
+//============================================================================
+// WyHash: a wyhash-style hash, the multiply of two 64-bit numbers folded
+// back into 64 bits doing the mixing
+//============================================================================
+
+static const uint64_t WY_P0 = 0xa0761d6478bd642full;
+static const uint64_t WY_P1 = 0xe7037ed1a0b428dbull;
+static const uint64_t WY_P2 = 0x8ebc6af09c88c6e3ull;
+static const uint64_t WY_P3 = 0x589965cc75374cc3ull;
+
+/**
+ * Multiply two 64-bit numbers into the low and high halves of the product
+ */
+static void wyMultiply(uint64_t& a, uint64_t& b) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    a = static_cast<uint64_t>(product);
+    b = static_cast<uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    a = _umul128(a, b, &b);
+#else
+    // four 32-bit products
+    uint64_t ha = a >> 32, hb = b >> 32, la = static_cast<uint32_t>(a), lb = static_cast<uint32_t>(b);
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t carry = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    carry += lo < t;
+    b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+    a = lo;
+#endif
+}
+
+/**
+ * The low and high halves of a product, folded together
+ */
+static uint64_t wyMix(uint64_t a, uint64_t b) {
+    wyMultiply(a, b);
+    return a ^ b;
+}
+
+static uint64_t wyRead8(const unsigned char* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t wyRead4(const unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * Hash a number
+ *
+ * @param key The number to hash
+ * @return 64 bits each depending on every bit of the key
+ */
+uint64_t WyHash::hash(uint64_t key) {
+    return wyMix(key ^ WY_P0, WY_P1);
+}
+
+/**
+ * Hash a string, 16 bytes at a time (48 for long ones)
+ *
+ * @param key The string to hash
+ * @return 64 bits each depending on every byte of the key
+ */
+uint64_t WyHash::hash(string_view key) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(key.data());
+    size_t len = key.size();
+    uint64_t seed = wyMix(WY_P0, WY_P1);
+    uint64_t a, b;
+
+    if (len <= 16) {
+        if (len >= 4) {
+            // two overlapping reads from each end cover 4 to 16 bytes
+            size_t step = (len >> 3) << 2;
+            a = (wyRead4(p) << 32) | wyRead4(p + step);
+            b = (wyRead4(p + len - 4) << 32) | wyRead4(p + len - 4 - step);
+        } else if (len > 0) {
+            a = (uint64_t(p[0]) << 16) | (uint64_t(p[len >> 1]) << 8) | p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            // three independent lanes
+            uint64_t seed1 = seed, seed2 = seed;
+            do {
+                seed = wyMix(wyRead8(p) ^ WY_P1, wyRead8(p + 8) ^ seed);
+                seed1 = wyMix(wyRead8(p + 16) ^ WY_P2, wyRead8(p + 24) ^ seed1);
+                seed2 = wyMix(wyRead8(p + 32) ^ WY_P3, wyRead8(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (i > 16) {
+            seed = wyMix(wyRead8(p) ^ WY_P1, wyRead8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        // the last 16 bytes, overlapping the ones before if need be
+        a = wyRead8(p + i - 16);
+        b = wyRead8(p + i - 8);
+    }
+    a ^= WY_P1;
+    b ^= seed;
+    wyMultiply(a, b);
+    return wyMix(a ^ WY_P0 ^ len, b ^ WY_P1);
+}
+
+/**
+ * Load a CSV file containing bids, handing each one to a container
+ *
+ * @param csvPath the path to the CSV file to load
+ * @param add called with every bid read, which it may move from
+ * @param reserve called first with about as many bids as are read
+ * @return where the bids read stop in the file, to follow it from there
+ */
+csv::Position loadBids(const string& csvPath, const BidSink& add, const BidReserve& reserve) {
+    // an unchanged file is rebuilt from its cached binary snapshot, without parsing
+    csv::Snapshot snapshot(3, 0, 1);
+    string snapshotPath = csv::Snapshot::pathFor(csvPath);
+    if (snapshot.load(snapshotPath, csvPath)) {
+        cout << "Loading snapshot " << snapshotPath << endl;
+        if (reserve) {
+            reserve(snapshot.size());
+        }
+        for (unsigned int i = 0; i < snapshot.size(); i++) {
+            Bid bid;
+            bid.bidId = snapshot.text(i, 0);
+            bid.title = snapshot.text(i, 1);
+            bid.fund = snapshot.text(i, 2);
+            // saved as a whole number of cents
+            bid.amount = csv::Money::fromCents(snapshot.integer(i, 0));
+            add(move(bid));
+        }
+        return snapshot.sourceEnd();
+    }
+
+    cout << "Loading CSV file " << csvPath << endl;
+    csv::Position end;
+
+    // stream the CSV file one row at a time instead of loading it whole,
+    // decoding each one straight into a bid
+    csv::Options options;
+    // skip malformed rows instead of stopping at the first one
+    options.lenient = true;
+
+    try {
+        csv::Reader file(csvPath, ',', options);
+        if (reserve) {
+            reserve(file.rowEstimate());
+        }
+
+        // loop to read rows of a CSV file, each one decoded into a bid
+        Bid bid;
+        while (file.read<BidMapping>(bid)) {
+            // record it for the snapshot before handing it over
+            snapshot.append({ bid.bidId, bid.title, bid.fund }, {}, { bid.amount.cents() });
+            add(move(bid));
+        }
+
+        end = file.position();
+
+        // report the rows that were skipped
+        for (const csv::Rejected& bad : file.getRejected()) {
+            cerr << "Skipped line " << bad.line << ": " << bad.text << endl;
+        }
+
+        // next time, load from this snapshot, unless it misses some rows
+        if (file.getRejected().empty()) {
+            snapshot.save(snapshotPath, csvPath, end);
+        }
+    } catch (csv::Error &e) {
+        std::cerr << e.what() << std::endl;
+    }
+    return end;
+}
+
+/**
+ * Load several CSV files at once, parsing them in parallel
+ *
+ * Bids are handed over in the order of the files, then of their rows, and
+ * a bid whose key (see BidKey) was seen before is reported and skipped.
+ *
+ * @param csvPaths the paths to the CSV files to load
+ * @param add called with every bid kept, which it may move from
+ * @param reserve called first with about as many bids as are kept
+ * @return where the bids read stop in the last file, to follow it from there
+ */
+csv::Position loadAllBids(const vector<string>& csvPaths, const BidSink& add,
+        const BidReserve& reserve) {
+    cout << "Loading " << csvPaths.size() << " CSV files" << endl;
+
+    csv::Options options;
+    options.lenient = true;
+    // as many files at a time as there are cores
+    options.threads = 0;
+
+    vector<csv::FileRows<Bid>> files = csv::readFiles<BidMapping>(csvPaths, ',', options);
+
+    if (reserve) {
+        size_t rows = 0;
+        for (const csv::FileRows<Bid>& file : files) {
+            rows += file.rows.size();
+        }
+        reserve(rows);
+    }
+
+    unordered_set<BidKey::Type> bidIds;
+    for (csv::FileRows<Bid>& file : files) {
+        if (!file.error.empty()) {
+            cerr << file.error << endl;
+        }
+        for (const csv::Rejected& bad : file.rejected) {
+            cerr << "Skipped line " << bad.line << " of " << file.path << ": " << bad.text << endl;
+        }
+        for (Bid& bid : file.rows) {
+            // the first bid of a key wins, as IDs the containers take as the
+            // same key are the same auction; add reports IDs not taken at all
+            BidKey::Type key;
+            if (BidKey::parse(bid.bidId, key) && !bidIds.insert(key).second) {
+                cerr << "Duplicate bid id " << bid.bidId << " in " << file.path << " skipped" << endl;
+                continue;
+            }
+            add(move(bid));
+        }
+    }
+    return files.empty() ? csv::Position() : files.back().end;
+}
+
+/**
+ * Hand over the bids appended to a followed CSV file since the last call,
+ * on the first one those after where it was resumed (all of them if not)
+ *
+ * @param follower the CSV file being followed
+ * @param add called with every bid read, which it may move from
+ * @return the number of bids added
+ */
+unsigned long followBids(csv::Follower* follower, const BidSink& add) {
+    size_t skipped = follower->getRejected().size();
+    unsigned long count = 0;
+
+    try {
+        Bid bid;
+        while (follower->read<BidMapping>(bid)) {
+            add(move(bid));
+            count++;
+        }
+    } catch (csv::Error &e) {
+        cerr << e.what() << endl;
+    }
+
+    // report the rows skipped by this call
+    const vector<csv::Rejected>& rejected = follower->getRejected();
+    for (size_t i = skipped; i < rejected.size(); i++) {
+        cerr << "Skipped line " << rejected[i].line << ": " << rejected[i].text << endl;
+    }
+    return count;
+}
@@ -0,0 +1,139 @@
+//============================================================================
+// Name        : Bid.hpp
+// Author      : David Towne
+// Version     : 1.0
+// Copyright   : Copyright © 2017 SNHU COCE
+// Description : Bid record and loaders shared by the bid containers
+//============================================================================
+
+#ifndef     _BID_HPP_
+# define    _BID_HPP_
+
+# include <charconv>
+# include <cstdint>
+# include <functional>
+# include <limits>
+# include <string>
+# include <string_view>
+# include <vector>
+
+# include "CSVparser.hpp"
+
+// define a structure to hold bid information
+struct Bid {
+    std::string bidId; // unique identifier
+    std::string title;
+    // a handful of funds for thousands of bids: each one is stored once
+    csv::Interned fund;
+    // exact to the cent
+    csv::Money amount;
+};
+
+// the columns of a bid in the CSV files, decoded straight into a Bid
+typedef csv::Mapping<Bid,
+    csv::Field<&Bid::title, 0>,
+    csv::Field<&Bid::bidId, 1>,
+    csv::Field<&Bid::amount, 4>,
+    csv::Field<&Bid::fund, 8> > BidMapping;
+
+/**
+ * Key policies: how the containers order and match their bids.
+ *
+ * A key is made once from the auction ID, when a bid is inserted, and kept
+ * next to it, so lookups compare keys rather than ID strings. StringKey
+ * keeps the ID text: every ID is a key, as it always was. NumberKey parses
+ * the ID ("98109") into an integer: one instruction to compare, and IDs
+ * that differ only by leading zeros are the same key, but a bid whose ID
+ * is not a number that fits is turned away.
+ */
+template <typename Int>
+struct NumberKey {
+    typedef Int Type;
+
+    // the key of a node not holding a bid yet
+    static Type none() {
+        return std::numeric_limits<Int>::max();
+    }
+
+    // make the key of an auction ID: false if it is not a number that fits
+    static bool parse(std::string_view bidId, Type& key) {
+        const char* end = bidId.data() + bidId.size();
+        std::from_chars_result result = std::from_chars(bidId.data(), end, key);
+        return result.ec == std::errc() && result.ptr == end;
+    }
+};
+
+struct StringKey {
+    typedef std::string Type;
+
+    static Type none() {
+        return Type();
+    }
+
+    // make the key of an auction ID, any of them
+    static bool parse(std::string_view bidId, Type& key) {
+        key.assign(bidId);
+        return true;
+    }
+};
+
+// the key policy of the containers: the ID text, unless built with
+// BID_NUMBER_KEYS for 32-bit numeric IDs or BID_WIDE_KEYS for 64-bit ones
+#if defined(BID_WIDE_KEYS)
+typedef NumberKey<uint64_t> BidKey;
+#elif defined(BID_NUMBER_KEYS)
+typedef NumberKey<uint32_t> BidKey;
+#else
+typedef StringKey BidKey;
+#endif
+
+/**
+ * Hash policies: how the hash tables turn a key into 64 bits, for either
+ * kind of key.
+ *
+ * WyHash mixes every bit of the key into every bit of the hash, along the
+ * lines of wyhash: sequential IDs, IDs with a common prefix and IDs that
+ * are not numbers spread alike. StdHash is std::hash, which returns a
+ * number unchanged and leaves the mixing to the table.
+ *
+ * The tables hash BidKey::Type, so the default build hashes the ID text
+ * with hash(std::string_view); hash(uint64_t) is only reached in a build
+ * with BID_NUMBER_KEYS or BID_WIDE_KEYS.
+ */
+struct WyHash {
+    static uint64_t hash(uint64_t key);
+    static uint64_t hash(std::string_view key);
+};
+
+struct StdHash {
+    static uint64_t hash(uint64_t key) {
+        return std::hash<uint64_t>()(key);
+    }
+
+    static uint64_t hash(std::string_view key) {
+        return std::hash<std::string_view>()(key);
+    }
+};
+
+// the hash policy of the hash tables: build with BID_STD_HASH for std::hash
+#if defined(BID_STD_HASH)
+typedef StdHash BidHash;
+#else
+typedef WyHash BidHash;
+#endif
+
+// where the loaders hand each bid read, moved: a container's Insert or Append
+typedef std::function<void(Bid&&)> BidSink;
+// told how many bids are coming before a load hands them over, if set
+typedef std::function<void(size_t)> BidReserve;
+
+void displayBid(const Bid& bid);
+Bid getBid();
+
+csv::Position loadBids(const std::string& csvPath, const BidSink& add,
+        const BidReserve& reserve = nullptr);
+csv::Position loadAllBids(const std::vector<std::string>& csvPaths, const BidSink& add,
+        const BidReserve& reserve = nullptr);
+unsigned long followBids(csv::Follower* follower, const BidSink& add);
+
+#endif /*!_BID_HPP_*/
@@ -6,32 +6,15 @@
 // Description : Lab 3-3 Lists and Searching
 //============================================================================
 
-#include <algorithm>
+#include <filesystem>
 #include <iostream>
+#include <string_view>
 #include <time.h>
 
-#include "CSVparser.hpp"
+#include "Bid.hpp"
 
 using namespace std;
 
-//============================================================================
-// Global definitions visible to all methods and classes
-//============================================================================
-
-// forward declarations
-double strToDouble(string str, char ch);
-
-// define a structure to hold bid information
-struct Bid {
-	string bidId; // unique identifier
-	string title;
-	string fund;
-	double amount;
-	Bid() {
-		amount = 0.0;
-	}
-};
-
 //============================================================================
 // Linked-List class definition
 //============================================================================
@@ -46,6 +29,8 @@ private:
 	//Internal structure for list entries, housekeeping variables
 	struct Node {
 		Bid bid;
+		// the key of the bid, which searches match
+		BidKey::Type key;
 		Node* next;
 
 		// default constructor
@@ -53,9 +38,10 @@ private:
 			next = nullptr;
 		}
 
-		// initialize a node with a bid
-		Node(Bid aBid) {
-			bid = aBid;
+		// initialize a node with a bid and its key, taking over its strings
+		Node(Bid&& aBid, BidKey::Type aKey) {
+			bid = move(aBid);
+			key = aKey;
 			next = nullptr;
 		}
 	};
@@ -64,14 +50,18 @@ private:
 	Node* tail;
 	int size = 0;
 
+	Node* newNode(Bid&& bid);
+
 public:
 	LinkedList();
 	virtual ~LinkedList();
-	void Append(Bid bid);
-	void Prepend(Bid bid);
+	void Append(Bid&& bid);
+	void Append(const Bid& bid);
+	void Prepend(Bid&& bid);
+	void Prepend(const Bid& bid);
 	void PrintList();
-	void Remove(string bidId);
-	Bid Search(string bidId);
+	void Remove(string_view bidId);
+	const Bid* Search(string_view bidId) const;
 	int Size();
 };
 
@@ -101,12 +91,29 @@ LinkedList::~LinkedList() {
 }
 
 /**
- * Append a new bid to the end of the list
+ * Make the node of a bid, keyed on its ID
+ *
+ * @return the new node, or nullptr if the ID is not a valid key
  */
-void LinkedList::Append(Bid bid) {
+LinkedList::Node* LinkedList::newNode(Bid&& bid) {
+	BidKey::Type key;
+	if (!BidKey::parse(bid.bidId, key)) {
+		cerr << "Bid id " << bid.bidId << " is not a valid key, skipped" << endl;
+		return nullptr;
+	}
+	return new Node(move(bid), key);
+}
+
+/**
+ * Append a new bid to the end of the list, moving it into the list
+ */
+void LinkedList::Append(Bid&& bid) {
 	// FIXME (2): Implement append logic
 	//Create new node
-	Node* node = new Node(bid);
+	Node* node = newNode(move(bid));
+	if (node == nullptr) {
+		return;
+	}
 	//if there is nothing at the head...
 	if (head == nullptr) {
 		head = node;
@@ -126,12 +133,22 @@ void LinkedList::Append(Bid bid) {
 }
 
 /**
- * Prepend a new bid to the start of the list
+ * Append a copy of a bid to the end of the list
+ */
+void LinkedList::Append(const Bid& bid) {
+	Append(Bid(bid));
+}
+
+/**
+ * Prepend a new bid to the start of the list, moving it into the list
  */
-void LinkedList::Prepend(Bid bid) {
+void LinkedList::Prepend(Bid&& bid) {
 	// FIXME (3): Implement prepend logic
 	// Create new node
-	Node* node = new Node(bid);
+	Node* node = newNode(move(bid));
+	if (node == nullptr) {
+		return;
+	}
 
 	// if there is already something at the head...
 		// new node points to current head as its next node
@@ -146,6 +163,13 @@ void LinkedList::Prepend(Bid bid) {
 
 }
 
+/**
+ * Prepend a copy of a bid to the start of the list
+ */
+void LinkedList::Prepend(const Bid& bid) {
+	Prepend(Bid(bid));
+}
+
 /**
  * Simple output of all bids in the list
  */
@@ -169,11 +193,15 @@ void LinkedList::PrintList() {
  *
  * @param bidId The bid id to remove from the list
  */
-void LinkedList::Remove(string bidId) {
+void LinkedList::Remove(string_view bidId) {
 	// FIXME (5): Implement remove logic
+	BidKey::Type key;
+	if (!BidKey::parse(bidId, key)) {
+		return;
+	}
 	// special case if matching node is the head
 	if (head != nullptr) {
-		if (head->bid.bidId.compare(bidId) == 0) {
+		if (head->key == key) {
 			// make head point to the next node in the list
 			Node* tempNode = head->next;
 			//decrease size count
@@ -186,7 +214,7 @@ void LinkedList::Remove(string bidId) {
 	// while loop over each node looking for a match
 		while (head->next != nullptr) {
 			// if the next node bidID is equal to the current bidID
-			if (head->next->bid.bidId.compare(bidId) == 0) {
+			if (head->next->key == key) {
 			// hold onto the next node temporarily
 			Node* tempNode = head->next;
 			 // make current node point beyond the next node
@@ -206,31 +234,34 @@ void LinkedList::Remove(string bidId) {
  * Search for the specified bidId
  *
  * @param bidId The bid id to search for
+ * @return the bid found, held by the list, or nullptr
  */
-Bid LinkedList::Search(string bidId) {
+const Bid* LinkedList::Search(string_view bidId) const {
 	// FIXME (6): Implement search logic
 	
 	// special case if matching node is the head
 		// make head point to the next node in the list
 		// return
 		//decrease size count
-		Node* temp = head;
-		Node* node = new Node;
-		node->bid.bidId = "";
+		const Node* temp = head;
+		BidKey::Type key;
+		if (!BidKey::parse(bidId, key)) {
+			return nullptr;
+		}
 
 	// start at the head of the list
 	// keep searching until end reached with while loop (temp != nullptr
 	 while (temp != nullptr) {
 		 cout << temp->bid.bidId << endl;
 		 // if the current node matches, return it
-		 if (temp->bid.bidId == bidId) {
-			 return temp->bid;
+		 if (temp->key == key) {
+			 return &temp->bid;
 		 }
 		 cout << temp->bid.title << " | " << temp->bid.amount
 			 << " | " << temp->bid.fund << endl;;
 		 temp = temp->next;
 	 }
-	 return node->bid;
+	 return nullptr;
 }
 
 /**
@@ -244,90 +275,6 @@ int LinkedList::Size() {
 // Static methods used for testing
 //============================================================================
 
-/**
- * Display the bid information
- *
- * @param bid struct containing the bid info
- */
-void displayBid(Bid bid) {
-	cout << bid.bidId << ": " << bid.title << " | " << bid.amount
-		<< " | " << bid.fund << endl;
-	return;
-}
-
-/**
- * Prompt user for bid information
- *
- * @return Bid struct containing the bid info
- */
-Bid getBid() {
-	Bid bid;
-
-	cout << "Enter Id: ";
-	cin.ignore();
-	getline(cin, bid.bidId);
-
-	cout << "Enter title: ";
-	getline(cin, bid.title);
-
-	cout << "Enter fund: ";
-	cin >> bid.fund;
-
-	cout << "Enter amount: ";
-	cin.ignore();
-	string strAmount;
-	getline(cin, strAmount);
-	bid.amount = strToDouble(strAmount, '$');
-
-	return bid;
-}
-
-/**
- * Load a CSV file containing bids into a LinkedList
- *
- * @return a LinkedList containing all the bids read
- */
-void loadBids(string csvPath, LinkedList* list) {
-	cout << "Loading CSV file " << csvPath << endl;
-
-	// initialize the CSV Parser
-	csv::Parser file = csv::Parser(csvPath);
-
-	try {
-		// loop to read rows of a CSV file
-		for (int i = 0; i < file.rowCount(); i++) {
-
-			// initialize a bid using data from current row (i)
-			Bid bid;
-			bid.bidId = file[i][1];
-			bid.title = file[i][0];
-			bid.fund = file[i][8];
-			bid.amount = strToDouble(file[i][4], '$');
-
-			//cout << bid.bidId << ": " << bid.title << " | " << bid.fund << " | " << bid.amount << endl;
-
-			// add this bid to the end
-			list->Append(bid);
-		}
-	}
-	catch (csv::Error& e) {
-		std::cerr << e.what() << std::endl;
-	}
-}
-
-/**
- * Simple C function to convert a string to a double
- * after stripping out unwanted char
- *
- * credit: http://stackoverflow.com/a/24875936
- *
- * @param ch The character to strip out
- */
-double strToDouble(string str, char ch) {
-	str.erase(remove(str.begin(), str.end(), ch), str.end());
-	return atof(str.c_str());
-}
-
 /**
  * The one and only main() method
  *
@@ -336,36 +283,55 @@ double strToDouble(string str, char ch) {
  */
 int main(int argc, char* argv[]) {
 
-	// process command line arguments
-	string csvPath, bidKey;
-	switch (argc) {
-	case 2:
-		csvPath = argv[1];
-		bidKey = "98109";
-		break;
-	case 3:
-		csvPath = argv[1];
-		bidKey = argv[2];
-		break;
-	default:
-		csvPath = "eBid_Monthly_Sales_Dec_2016.csv";
-		bidKey = "98109";
+	// process command line arguments: CSV files (or directories of them),
+	// then the bid key unless the last one is a file too
+	vector<string> csvPaths;
+	string bidKey = "98109";
+	for (int i = 1; i < argc; i++) {
+		if (i > 1 && i == argc - 1 && !filesystem::exists(argv[i])) {
+			bidKey = argv[i];
+		} else {
+			csvPaths.push_back(argv[i]);
+		}
+	}
+	if (csvPaths.empty()) {
+		csvPaths.push_back("eBid_Monthly_Sales_Dec_2016.csv");
 	}
+	csvPaths = csv::listFiles(csvPaths);
 
 	clock_t ticks;
 
 	LinkedList bidList;
 
 	Bid bid;
+	const Bid* found = nullptr;
+
+	// the loaders move every bid they read to the end of the list
+	BidSink addBid = [&bidList](Bid&& bid) {
+		bidList.Append(move(bid));
+	};
+
+	// the newest CSV file, followed from choice 6 on: it is polled for
+	// new bids before every prompt
+	csv::Follower* follower = nullptr;
+	// where the last load stopped in that file
+	csv::Position loaded;
 
 	int choice = 0;
 	while (choice != 9) {
+		if (follower != nullptr) {
+			unsigned long added = followBids(follower, addBid);
+			if (added > 0) {
+				cout << added << " new bids in " << csvPaths.back() << endl;
+			}
+		}
 		cout << "Menu:" << endl;
 		cout << "  1. Enter a Bid" << endl;
 		cout << "  2. Load Bids" << endl;
 		cout << "  3. Display All Bids" << endl;
 		cout << "  4. Find Bid" << endl;
 		cout << "  5. Remove Bid" << endl;
+		cout << "  6. Follow Bids" << endl;
 		cout << "  9. Exit" << endl;
 		cout << "Enter choice: ";
 		cin >> choice;
@@ -381,7 +347,15 @@ int main(int argc, char* argv[]) {
 		case 2:
 			ticks = clock();
 
-			loadBids(csvPath, &bidList);
+			if (csvPaths.size() == 1) {
+
+				loaded = loadBids(csvPaths[0], addBid);
+
+			} else {
+
+				loaded = loadAllBids(csvPaths, addBid);
+
+			}
 
 			cout << bidList.Size() << " bids read" << endl;
 
@@ -399,12 +373,12 @@ int main(int argc, char* argv[]) {
 		case 4:
 			ticks = clock();
 
-			bid = bidList.Search(bidKey);
+			found = bidList.Search(bidKey);
 
 			ticks = clock() - ticks; // current clock ticks minus starting clock ticks
 
-			if (!bid.bidId.empty()) {
-				displayBid(bid);
+			if (found != nullptr) {
+				displayBid(*found);
 			}
 			else {
 				cout << "Bid Id " << bidKey << " not found." << endl;
@@ -419,9 +393,29 @@ int main(int argc, char* argv[]) {
 			bidList.Remove(bidKey);
 
 			break;
+
+		case 6:
+			// load the bids of the newest file not loaded yet, then keep
+			// adding the ones appended to it
+			if (follower == nullptr) {
+				csv::Options options;
+				options.lenient = true;
+				follower = new csv::Follower(csvPaths.back(), ',', options);
+				follower->resume(loaded);
+			}
+			ticks = clock();
+
+			cout << followBids(follower, addBid) << " bids read from " << csvPaths.back() << endl;
+
+			ticks = clock() - ticks; // current clock ticks minus starting clock ticks
+			cout << "time: " << ticks << " clock ticks" << endl;
+			cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
+			break;
 		}
 	}
 
+	delete follower;
+
 	cout << "Good bye." << endl;
 
 	return 0;
@@ -7,110 +7,18 @@
 //============================================================================
 
 #include <algorithm>
+#include <filesystem>
 #include <iostream>
 #include <time.h>
 
-#include "CSVparser.hpp"  // include parsing library
+#include "Bid.hpp"  // bid record and loaders, over the parsing library
 
 using namespace std;
 
-//============================================================================
-// Global definitions visible to all methods and classes
-//============================================================================
-
-// forward declarations
-double strToDouble(string str, char ch);
-
-// define a structure to hold bid information
-struct Bid {
-    string bidId; // unique identifier
-    string title;
-    string fund;
-    double amount;
-    Bid() {
-        amount = 0.0;
-    }
-};
-
 //============================================================================
 // Static methods used for testing
 //============================================================================
 
-/**
- * Display the bid information to the console (std::out)
- *
- * @param bid struct containing the bid info
- */
-void displayBid(Bid bid) {
-    cout << bid.bidId << ": " << bid.title << " | " << bid.amount << " | "
-            << bid.fund << endl;
-    return;
-}
-
-/**
- * Prompt user for bid information using console (std::in)
- *
- * @return Bid struct containing the bid info
- */
-Bid getBid() {
-    Bid bid;
-
-    cout << "Enter Id: ";
-    cin.ignore();
-    getline(cin, bid.bidId);
-
-    cout << "Enter title: ";
-    getline(cin, bid.title);
-
-    cout << "Enter fund: ";
-    cin >> bid.fund;
-
-    cout << "Enter amount: ";
-    cin.ignore();
-    string strAmount;
-    getline(cin, strAmount);
-    bid.amount = strToDouble(strAmount, '$');
-
-    return bid;
-}
-
-/**
- * Load a CSV file containing bids into a container
- *
- * @param csvPath the path to the CSV file to load
- * @return a container holding all the bids read
- */
-vector<Bid> loadBids(string csvPath) {
-    cout << "Loading CSV file " << csvPath << endl;
-
-    // Define a vector data structure to hold a collection of bids.
-    vector<Bid> bids;
-
-    // initialize the CSV Parser using the given path
-    csv::Parser file = csv::Parser(csvPath);
-
-    try {
-        // loop to read rows of a CSV file
-        for (int i = 0; i < file.rowCount(); i++) {
-
-            // Create a data structure and add to the collection of bids
-            Bid bid;
-            bid.bidId = file[i][1];
-            bid.title = file[i][0];
-            bid.fund = file[i][8];
-            bid.amount = strToDouble(file[i][4], '$');
-
-            //cout << "Item: " << bid.title << ", Fund: " << bid.fund << ", Amount: " << bid.amount << endl;
-
-            // push this bid to the end
-            bids.push_back(bid);
-        }
-    } catch (csv::Error &e) {
-        std::cerr << e.what() << std::endl;
-    }
-    return bids;
-}
-
 // FIXME (2a): Implement the quick sort logic over bid.title
 
 /**
@@ -231,19 +139,6 @@ void selectionSort(vector<Bid>& bids) {
     }
 }
 
-/**
- * Simple C function to convert a string to a double
- * after stripping out unwanted char
- *
- * credit: http://stackoverflow.com/a/24875936
- *
- * @param ch The character to strip out
- */
-double strToDouble(string str, char ch) {
-    str.erase(remove(str.begin(), str.end(), ch), str.end());
-    return atof(str.c_str());
-}
-
 /**
  * The one and only main() method
  */
@@ -293,12 +188,27 @@ int main(int argc, char* argv[]) {
         default:
             csvPath;
         }
+
+    // several CSV files (or directories of them) are loaded together
+    vector<string> csvPaths;
+    for (int i = 1; i < argc; i++) {
+        csvPaths.push_back(argv[i]);
+    }
+    csvPaths = csv::listFiles(csvPaths);
+    if (csvPaths.size() == 1) {
+        csvPath = csvPaths[0];
+    }
     
    
 
     // Define a vector to hold all the bids
     vector<Bid> bids;
 
+    // the loaders move every bid they read to the end of the vector
+    BidSink addBid = [&bids](Bid&& bid) {
+        bids.push_back(move(bid));
+    };
+
     // Define a timer variable
     clock_t ticks;
 
@@ -320,7 +230,12 @@ int main(int argc, char* argv[]) {
             ticks = clock();
 
             // Complete the method call to load the bids
-            bids = loadBids(csvPath);
+            bids.clear();
+            if (csvPaths.size() > 1) {
+                loadAllBids(csvPaths, addBid);
+            } else {
+                loadBids(csvPath, addBid);
+            }
 
             cout << bids.size() << " bids read" << endl;
 